@@ -0,0 +1,33 @@
+#!/bin/bash
+
+# Benchmark suite behind "make bench": runs every pager at every frame count
+# on a deterministic tracegen workload streamed straight into mmu (no temp
+# files) and reports references/second, faults/second and peak RSS.
+# Results go to stdout and ${BENCH_OUT}; rows are always in the same order
+# and columns are fixed width, so two result files can be diffed directly.
+#
+#example BENCH_FRAMES="16 32" BENCH_GEN="procs=4 inst=100000" ./bench.sh
+
+MMU=${MMU:-./mmu}
+TRACEGEN=${TRACEGEN:-./tracegen}
+RFILE=${RFILE:-rfile}
+BENCH_OUT=${BENCH_OUT:-bench_output.txt}
+
+BENCH_ALGOS=${BENCH_ALGOS:-"f r c e a w arc car 2q lirs"}
+BENCH_FRAMES=${BENCH_FRAMES:-"16 128 1024 16384 1048576"}
+BENCH_GEN=${BENCH_GEN:-"procs=64 vmas=6 inst=1000000 read=75 lambda=1.9 holes=2 wprot=2 mmap=1 seed=4800"}
+
+[[ ! -x ${MMU} || ! -x ${TRACEGEN} ]] && echo "${MMU} or ${TRACEGEN} not found, run make first" && exit 1
+
+{
+    echo "# mmu bench: tracegen ${BENCH_GEN}"
+    printf "%-5s %8s %10s %12s %10s %12s %10s\n" "algo" "frames" "refs" "refs/s" "faults" "faults/s" "rss_kb"
+    for A in ${BENCH_ALGOS}; do
+        for N in ${BENCH_FRAMES}; do
+            # BENCH <instructions> <refs> <faults> <seconds> <peak rss kB>
+            ${MMU} -f${N} -a${A} -oB <(${TRACEGEN} ${BENCH_GEN}) ${RFILE} | awk -v a=${A} -v n=${N} '/^BENCH/ {
+                printf "%-5s %8d %10d %12.0f %10d %12.0f %10d\n", a, n, $3, $3 / $5, $4, $4 / $5, $6
+            }'
+        done
+    done
+} | tee ${BENCH_OUT}
@@ -0,0 +1,65 @@
+#!/bin/bash
+
+# Self-checking sweep behind "make check": runs mmu -d (reference and
+# optimized implementation of each pager in lockstep) over every input, frame
+# count and algorithm. Needs no reference outputs; a '.' is a run whose two
+# implementations agreed at every victim selection, a '#' one that diverged.
+# The DIFF report of every divergent run goes to the log.
+#
+#example INPUTS="1 2" FRAMES="8 16" MMUARGS="-L -q quotas" ./diffcheck.sh [logfile]
+
+MMU=${MMU:-./mmu}
+RFILE=${RFILE:-rfile}
+LOG=${1:-diffcheck.log}
+
+INPUTS=${INPUTS:-"`seq 1 11`"}
+ALGOS=${ALGOS:-"f r c e a w arc car 2q lirs"}
+FRAMES=${FRAMES:-"16 32"}
+MMUARGS=${MMUARGS:-}
+
+[[ ! -x ${MMU} ]] && echo "${MMU} not found, run make first" && exit 1
+
+declare -ai counters
+declare -i x=0 failed=0
+for A in ${ALGOS}; do
+    let counters[$x]=0
+    let x=$x+1
+done
+
+rm -f ${LOG}
+
+printf "%-7s %-7s" "input" "frames"
+for A in ${ALGOS}; do printf " %4s" "${A}"; done
+echo
+
+for I in ${INPUTS}; do
+    for N in ${FRAMES}; do
+        OUTLINE=`printf "%-7s %-7s" "${I}" "${N}"`
+        x=0
+        for A in ${ALGOS}; do
+            REPORT=$(${MMU} -f${N} -a${A} ${MMUARGS} -d inputs/in${I} ${RFILE} 2>&1)
+            if [[ $? == 0 ]]; then
+                OUTLINE=`printf "%s    ." "${OUTLINE}"`
+                let counters[$x]=${counters[$x]}+1
+            else
+                echo "${MMU} -f${N} -a${A} ${MMUARGS} -d inputs/in${I} ${RFILE}" >> ${LOG}
+                echo "${REPORT}" >> ${LOG}
+                OUTLINE=`printf "%s    #" "${OUTLINE}"`
+                let failed=$failed+1
+            fi
+            let x=$x+1
+        done
+        echo "${OUTLINE}"
+    done
+done
+
+OUTLINE=`printf "%-15s" "SUM"`
+x=0
+for A in ${ALGOS}; do
+    OUTLINE=`printf "%s %4d" "${OUTLINE}" "${counters[$x]}"`
+    let x=$x+1
+done
+echo "${OUTLINE}"
+
+[[ ${failed} -gt 0 ]] && echo "${failed} divergent runs, see ${LOG}" && exit 1
+exit 0
@@ -0,0 +1,48 @@
+#!/bin/bash
+
+# Measures simulated instructions/second of every algorithm for two builds of
+# mmu.cpp: the one at git revision BASE and the one in the working tree.
+# The workload is the instruction section of INPUT repeated REPEAT times.
+#
+#example BASE=HEAD~1 ./loopbench.sh
+
+BASE=${BASE:-HEAD}
+INPUT=${INPUT:-inputs/in10}
+REPEAT=${REPEAT:-100}
+FRAMES=${FRAMES:-32}
+ALGOS=${ALGOS:-"f r c e a w arc car 2q lirs"}
+RFILE=${RFILE:-rfile}
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:-"-w -std=c++2a -O2 -pthread"}
+LDLIBS=${LDLIBS:-"-lz"}
+
+TMP=$(mktemp -d)
+trap "rm -rf ${TMP}" EXIT
+
+git show ${BASE}:mmu.cpp > ${TMP}/before.cpp || exit 1
+${CXX} ${CXXFLAGS} ${TMP}/before.cpp -o ${TMP}/before ${LDLIBS} || exit 1
+${CXX} ${CXXFLAGS} mmu.cpp -o ${TMP}/after ${LDLIBS} || exit 1
+
+# header and process section once, instruction section REPEAT times
+sed '/^#### instruction simulation/q' ${INPUT} > ${TMP}/trace
+sed '1,/^#### instruction simulation/d' ${INPUT} > ${TMP}/insts
+for ((i = 0; i < REPEAT; i++)); do cat ${TMP}/insts; done >> ${TMP}/trace
+
+# prints "<instructions> <seconds>" for one run
+run() {
+    local start end inst
+    start=$(date +%s.%N)
+    inst=$($1 -f${FRAMES} -a$2 -oS ${TMP}/trace ${RFILE} 2>/dev/null | awk '/^TOTALCOST/ { print $2 }')
+    end=$(date +%s.%N)
+    echo "${inst} $(awk -v s=${start} -v e=${end} 'BEGIN { print e - s }')"
+}
+
+printf "%-6s %14s %14s %8s   (instructions/second, %s frames, base %s)\n" "algo" "before" "after" "speedup" "${FRAMES}" "${BASE}"
+for A in ${ALGOS}; do
+    read INST_B SEC_B <<< $(run ${TMP}/before ${A})
+    read INST_A SEC_A <<< $(run ${TMP}/after ${A})
+    awk -v a=${A} -v ib="${INST_B}" -v sb=${SEC_B} -v ia=${INST_A} -v sa=${SEC_A} 'BEGIN {
+        if (ib == "") printf "%-6s %14s %14.0f %8s\n", a, "-", ia / sa, "-"
+        else printf "%-6s %14.0f %14.0f %7.2fx\n", a, ib / sb, ia / sa, sb / sa
+    }'
+done
@@ -9,13 +9,35 @@
 #include <cctype>
 #include <algorithm>
 #include <queue>
-#include <unistd.h> // for getopt
+#include <list>
+#include <variant>
+#include <type_traits>
+#include <chrono>
+#include <cstring>
+#include <unistd.h> // for getopt and fork
+#include <sys/wait.h> // for waitpid
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <zlib.h>
+#include <sys/resource.h> // for getrusage
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h> // for __rdtsc
+#endif
 #include <cstdlib>  // for exit and stoi
 #include <climits>  // For UINT_MAX
 
 
 // Constants
 const int NUM_VIRTUAL_PAGES = 64; // Number of virtual pages per process
+const int MAX_FRAMES = 1 << 20;   // Limited by pte_t::frame_number
 bool o_flag = false;
 
 // Global variable for the number of frames, initialized later
@@ -27,6 +49,287 @@ unsigned long inst_count = 0;  //
 std::vector<int> randvals; // Store the random values read from file
 int ofs = 0;          // Offset in the randvals vector
 
+// Line reader for the trace and random files. "-" is stdin, gzip input is
+// inflated with zlib and zstd input is piped through "zstd -dc". A producer
+// thread reads and decompresses into one of two fixed-size buffers while the
+// simulation parses the other, so decompression overlaps with simulation and
+// the uncompressed trace never has to be stored.
+class InputStream {
+private:
+    enum Format { PLAIN, GZIP };
+    static const size_t BUFFER_SIZE = 1 << 20;
+    static const size_t INPUT_SIZE = 1 << 18;   // Compressed bytes per read
+
+    struct Buffer {
+        std::vector<char> data = std::vector<char>(BUFFER_SIZE);
+        size_t size = 0;
+        bool last = false;       // End of input (or error) after this buffer
+    };
+
+    std::string name;
+    int fd = -1;
+    bool regular = false;        // Regular file, can be opened again (see branches)
+    Format format = PLAIN;
+    pid_t zstd_pid = -1;
+    std::vector<char> input;     // Compressed bytes (and the sniffed magic number)
+    size_t input_start = 0, input_end = 0;
+    z_stream zs;
+    bool member_done = false;    // At the end of a gzip member (gzip files may have several)
+
+    Buffer buffers[2];
+    bool full[2] = { false, false };
+    int fill_index = 0;          // Next buffer for the producer
+    bool finished = false;       // Producer has published the last buffer
+    bool stopping = false;
+    std::string error;           // Set by the producer, reported by the consumer
+    std::thread producer;
+    std::mutex mutex;
+    std::condition_variable ready;
+
+    int current = 0;             // Buffer being consumed
+    bool holding = false;        // Consumer owns buffers[current]
+    size_t pos = 0;
+    unsigned long long consumed = 0;
+
+    bool read_input() {
+        ssize_t n;
+        do {
+            n = read(fd, input.data(), input.size());
+        } while (n == -1 && errno == EINTR);
+        if (n == -1) error = strerror(errno);
+        input_start = 0;
+        input_end = n > 0 ? n : 0;
+        return n > 0;
+    }
+
+    // Decompressed data into 'buffer' until it is full or the input ends
+    void fill(Buffer& buffer) {
+        buffer.size = 0;
+        while (buffer.size < BUFFER_SIZE && error.empty()) {
+            if (input_start == input_end && !read_input()) {
+                if (error.empty() && format == GZIP && !member_done) error = "truncated gzip stream";
+                if (error.empty() && zstd_pid != -1) {
+                    int status;
+                    waitpid(zstd_pid, &status, 0);
+                    zstd_pid = -1;
+                    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) error = "zstd -dc failed (is zstd installed?)";
+                }
+                buffer.last = true;
+                return;
+            }
+            if (format == PLAIN) {
+                size_t n = std::min(input_end - input_start, BUFFER_SIZE - buffer.size);
+                memcpy(buffer.data.data() + buffer.size, input.data() + input_start, n);
+                buffer.size += n;
+                input_start += n;
+                continue;
+            }
+            if (member_done) {
+                inflateReset(&zs);  // Another gzip member follows
+            }
+            zs.next_in = reinterpret_cast<Bytef*>(input.data() + input_start);
+            zs.avail_in = input_end - input_start;
+            zs.next_out = reinterpret_cast<Bytef*>(buffer.data.data() + buffer.size);
+            zs.avail_out = BUFFER_SIZE - buffer.size;
+            int ret = inflate(&zs, Z_NO_FLUSH);
+            input_start = input_end - zs.avail_in;
+            buffer.size = BUFFER_SIZE - zs.avail_out;
+            if (ret == Z_STREAM_END) {
+                member_done = true;
+            } else if (ret == Z_OK || ret == Z_BUF_ERROR) {
+                member_done = false;
+            } else {
+                error = std::string("gzip: ") + (zs.msg ? zs.msg : "corrupt data");
+            }
+        }
+        buffer.last = !error.empty();
+    }
+
+    void produce() {
+        while (true) {
+            int i = fill_index;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [&] { return !full[i] || stopping; });
+                if (stopping) return;
+            }
+            fill(buffers[i]);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                full[i] = true;
+                fill_index = i ^ 1;
+                finished = buffers[i].last;
+            }
+            ready.notify_all();
+            if (finished) return;
+        }
+    }
+
+    // Hand the current buffer back to the producer and wait for the next one
+    bool next_buffer() {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (holding) {
+            if (buffers[current].last) return false;
+            full[current] = false;
+            current ^= 1;
+            ready.notify_all();
+        }
+        ready.wait(lock, [&] { return full[current]; });
+        holding = true;
+        pos = 0;
+        if (buffers[current].last && !error.empty()) {
+            std::cerr << "Error reading " << name << ": " << error << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        return true;
+    }
+
+    bool spawn_zstd() {
+        int pipefd[2];
+        if (pipe(pipefd) == -1) return false;
+        zstd_pid = fork();
+        if (zstd_pid == -1) return false;
+        if (zstd_pid == 0) {
+            dup2(pipefd[1], STDOUT_FILENO);
+            ::close(pipefd[0]);
+            ::close(pipefd[1]);
+            execlp("zstd", "zstd", "-dcq", "--", name.c_str(), (char*)nullptr);
+            _exit(127);
+        }
+        ::close(pipefd[1]);
+        ::close(fd);
+        fd = pipefd[0];
+        return true;
+    }
+
+public:
+    ~InputStream() {
+        close();
+    }
+
+    const std::string& last_error() const { return error; }
+    bool reopenable() const { return regular; }
+    unsigned long long tell() const { return consumed; }
+
+    bool open(const std::string& filename) {
+        close();
+        name = filename;
+        fd = filename == "-" ? dup(STDIN_FILENO) : ::open(filename.c_str(), O_RDONLY);
+        if (fd == -1) {
+            error = strerror(errno);
+            return false;
+        }
+        struct stat st;
+        regular = filename != "-" && fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+
+        // Sniff the format from the magic number; the bytes stay in the input
+        input.resize(INPUT_SIZE);
+        input_start = input_end = 0;
+        while (input_end < 4) {
+            ssize_t n = read(fd, input.data() + input_end, 4 - input_end);
+            if (n <= 0) break;
+            input_end += n;
+        }
+        const unsigned char* magic = reinterpret_cast<const unsigned char*>(input.data());
+        if (input_end >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+            format = GZIP;
+            memset(&zs, 0, sizeof(zs));
+            if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) {
+                error = "cannot initialize zlib";
+                return false;
+            }
+        } else if (input_end == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+            if (!regular) {
+                error = "zstd input must be a file, decompress pipes with zstd -dc";
+                return false;
+            }
+            if (!spawn_zstd()) {
+                error = strerror(errno);
+                return false;
+            }
+            input_end = 0;
+        }
+        producer = std::thread(&InputStream::produce, this);
+        return true;
+    }
+
+    void close() {
+        suspend();
+        if (fd != -1) ::close(fd);
+        if (zstd_pid != -1) waitpid(zstd_pid, nullptr, 0);
+        if (format == GZIP) inflateEnd(&zs);
+        fd = -1;
+        zstd_pid = -1;
+        format = PLAIN;
+        member_done = false;
+        full[0] = full[1] = false;
+        buffers[0].last = buffers[1].last = false;
+        fill_index = current = 0;
+        finished = holding = false;
+        pos = 0;
+        consumed = 0;
+        error.clear();
+    }
+
+    // Stop the producer between two buffers (it must not run across a fork)
+    void suspend() {
+        if (!producer.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_all();
+        producer.join();
+        stopping = false;
+    }
+
+    void resume() {
+        if (fd != -1 && !finished && !producer.joinable()) {
+            producer = std::thread(&InputStream::produce, this);
+        }
+    }
+
+    bool getline(std::string& line) {
+        line.clear();
+        while (true) {
+            if (!holding || pos == buffers[current].size) {
+                if (!next_buffer()) return !line.empty();
+                continue;
+            }
+            const char* start = buffers[current].data.data() + pos;
+            size_t avail = buffers[current].size - pos;
+            const char* newline = static_cast<const char*>(memchr(start, '\n', avail));
+            size_t n = newline ? newline - start : avail;
+            line.append(start, n);
+            pos += n;
+            consumed += n;
+            if (newline) {
+                pos++;
+                consumed++;
+                return true;
+            }
+        }
+    }
+
+    // Move forward to a position returned by tell() (decompressing what is skipped)
+    bool skip_to(unsigned long long offset) {
+        while (consumed < offset) {
+            if (!holding || pos == buffers[current].size) {
+                if (!next_buffer()) return false;
+                continue;
+            }
+            size_t n = std::min<unsigned long long>(buffers[current].size - pos, offset - consumed);
+            pos += n;
+            consumed += n;
+        }
+        return consumed == offset;
+    }
+};
+
+bool getline(InputStream& in, std::string& line) {
+    return in.getline(line);
+}
+
 int myrandom(int burst) {
     int rand = 1 + (randvals[ofs] % burst);
     ofs = (ofs + 1) % randvals.size();
@@ -34,13 +337,20 @@ int myrandom(int burst) {
 }
 
 void readRandomNumbers(const std::string& filename) {
-    std::ifstream file(filename);
+    InputStream file;
+    if (!file.open(filename)) {
+        std::cerr << "Failed to open random file: " << filename << " (" << file.last_error() << ")" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::string line;
     int num;
-    int count;  // To hold the number of random numbers in the file
+    bool counted = false;  // The first number is the count
 
-    if (file >> count) {  // Read the first number which is the count
-        while (file >> num) {
-            randvals.push_back(num);
+    while (getline(file, line)) {
+        std::istringstream iss(line);
+        while (iss >> num) {
+            if (counted) randvals.push_back(num);
+            counted = true;
         }
     }
     file.close();
@@ -48,6 +358,7 @@ void readRandomNumbers(const std::string& filename) {
 
 
 struct ProcessStats {
+    unsigned long refs = 0;   // Read/write instructions issued (not part of the cost)
     unsigned long maps = 0;
     unsigned long unmaps = 0;
     unsigned long ins = 0;
@@ -84,8 +395,8 @@ struct pte_t {
     unsigned int paged_out     : 1;
     unsigned int file_mapped   : 1;  // Added to indicate file mapping
     // unsigned int isValid       : 2;  // 0: Not Initialized, 1: Initialized but not Valid, 2: Inititalized and Valid
-    unsigned int frame_number  : 7;  // Enough for 128 frames
-    unsigned int unused        : 19; // Adjusted for the additional bit
+    unsigned int frame_number  : 20; // Enough for MAX_FRAMES frames
+    unsigned int unused        : 6;  // Adjusted for the additional bit
 
     // Default constructor to initialize all bits to zero
     pte_t() : present(0), write_protect(0), modified(0), referenced(0), paged_out(0), frame_number(0), file_mapped(0), unused(0) {}
@@ -106,12 +417,9 @@ public:
     unsigned int age = 0;     // Aging register/Last time the frame was used
     unsigned int age_ = 0;
 
-    std::vector<char> data;   // Simulated frame data
-
-    frame_t() : data(4096, 0) {}  // Assume each frame is 4KB
-
+    // Frame contents are not simulated: keeping 4KB per frame dominated the
+    // memory footprint and zeroing it dominated the cost of a ZERO
     void clear() {
-        std::fill(data.begin(), data.end(), 0);  // Reset all data to zero
         age = 0;
     }
 
@@ -127,6 +435,8 @@ public:
 std::vector<frame_t> frame_table; 
 std::deque<frame_t*> free_frames;
 
+class Pager;
+
 // Extend the Process structure to include VMAs
 struct Process {
     int pid;                             // Process ID
@@ -134,7 +444,18 @@ struct Process {
     std::vector<pte_t> page_table;         // Vector of PTEs
     ProcessStats stats; 
 
-    Process(int id) : pid(id) {
+    // Frame allocation (see load_quotas), enforced in local replacement mode
+    unsigned int quota;                  // Max frames the process may currently hold
+    unsigned int max_quota;              // Upper bound for working-set driven adjustment
+    unsigned int reserve = 0;            // Frames guaranteed to the process
+    std::vector<frame_t*> frames;        // Frames owned by the process
+    Pager* pager = nullptr;              // Per-process pager over 'frames'
+    bool exited = false;
+
+    std::vector<unsigned int> ws_stamp;  // Adjustment window in which each page was last referenced
+    unsigned int ws_size = 0;            // Distinct pages referenced in the current window
+
+    Process(int id) : pid(id), quota(numFrames), max_quota(numFrames), ws_stamp(NUM_VIRTUAL_PAGES, 0) {
         // Initialize the page table with the correct number of entries
         page_table.resize(NUM_VIRTUAL_PAGES); 
         for (int i = 0; i < NUM_VIRTUAL_PAGES; ++i) {
@@ -155,29 +476,228 @@ struct Process {
 
 std::vector<Process> processes;
 
+// Flat binary image of simulator state for checkpoints (-c/-r). Values are
+// stored in native layout: a checkpoint is only meant to be read back by the
+// same build on the same machine.
+class Snapshot {
+private:
+    std::string data;
+    size_t pos = 0;
+
+    void need(size_t bytes) {
+        if (pos + bytes > data.size()) throw std::runtime_error("truncated checkpoint");
+    }
+
+public:
+    template <class T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "only plain values can be stored");
+        data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <class T>
+    void put(const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable_v<T>, "only plain values can be stored");
+        put(values.size());
+        data.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    void put(const std::string& value) {
+        put(value.size());
+        data.append(value);
+    }
+
+    template <class T>
+    void get(T& value) {
+        need(sizeof(T));
+        memcpy(&value, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+    }
+
+    template <class T>
+    void get(std::vector<T>& values) {
+        size_t count;
+        get(count);
+        need(count * sizeof(T));
+        values.resize(count);
+        if (count) memcpy(values.data(), data.data() + pos, count * sizeof(T));
+        pos += count * sizeof(T);
+    }
+
+    void get(std::string& value) {
+        size_t count;
+        get(count);
+        need(count);
+        value.assign(data, pos, count);
+        pos += count;
+    }
+
+    bool write(const std::string& filename) const {
+        std::ofstream file(filename, std::ios::binary);
+        file.write(data.data(), data.size());
+        return file.good();
+    }
+
+    bool read(const std::string& filename) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) return false;
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        pos = 0;
+        return true;
+    }
+};
+
 // Abstract base class for page replacement algorithms
 class Pager {
 public:
-    virtual frame_t* select_victim_frame(std::vector<frame_t>& frame_table, std::vector<Process>& processes, unsigned long inst_count) = 0;
+    virtual ~Pager() {}
+
+    virtual frame_t* select_victim_frame(std::vector<frame_t*>& frames, std::vector<Process>& processes, unsigned long inst_count) = 0;
+
+    // Event hooks for pagers that keep their own bookkeeping (ghost lists etc.)
+    virtual void on_fault(int pid, int vpage) {}   // before a frame is requested for pid:vpage
+    virtual void on_map(frame_t* frame) {}         // frame now holds the faulting page
+    // Hits in a row on one page must settle after two calls, into a fixed point
+    // or a cycle of two (LIRS with no LIR capacity), so that simulate() can apply
+    // long runs with at most three calls; -d checks this against single steps.
+    virtual void on_reference(frame_t* frame) {}   // access to an already resident page
+    virtual void on_unmap(frame_t* frame) {}       // frame released by process exit (not an eviction)
+
+    // Checkpoints: internal state beyond the frame and page tables (hands, lists, ...)
+    virtual void save(Snapshot& snap) const {}
+    virtual void load(Snapshot& snap) {}
+};
+
+// Unique index of a virtual page across all processes
+inline int page_key(int pid, int vpage) {
+    return pid * NUM_VIRTUAL_PAGES + vpage;
+}
+
+// Intrusive doubly-linked list over page keys. Every operation is O(1);
+// front() is the oldest (LRU) end and back() the newest (MRU) end.
+class PageList {
+private:
+    std::vector<int> prev_, next_;
+    std::vector<char> member_;
+    int head = -1, tail = -1;
+    size_t count = 0;
+
+public:
+    explicit PageList(size_t keys = 0) : prev_(keys, -1), next_(keys, -1), member_(keys, 0) {}
+
+    bool contains(int key) const { return member_[key]; }
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    int front() const { return head; }
+
+    void push_back(int key) {
+        prev_[key] = tail;
+        next_[key] = -1;
+        if (tail != -1) next_[tail] = key; else head = key;
+        tail = key;
+        member_[key] = 1;
+        count++;
+    }
+
+    void remove(int key) {
+        if (prev_[key] != -1) next_[prev_[key]] = next_[key]; else head = next_[key];
+        if (next_[key] != -1) prev_[next_[key]] = prev_[key]; else tail = prev_[key];
+        member_[key] = 0;
+        count--;
+    }
+
+    // -1 (and no change) when the list is empty
+    int pop_front() {
+        int key = head;
+        if (key != -1) remove(key);
+        return key;
+    }
+
+    void move_to_back(int key) {
+        remove(key);
+        push_back(key);
+    }
+
+    void save(Snapshot& snap) const {
+        snap.put(prev_);
+        snap.put(next_);
+        snap.put(member_);
+        snap.put(head);
+        snap.put(tail);
+        snap.put(count);
+    }
+
+    void load(Snapshot& snap) {
+        snap.get(prev_);
+        snap.get(next_);
+        snap.get(member_);
+        snap.get(head);
+        snap.get(tail);
+        snap.get(count);
+    }
+};
+
+// Plain std::list with the PageList interface; lookups are linear. This is
+// the reference the ghost-list pagers are checked against with -d.
+class ReferenceList {
+private:
+    std::list<int> keys;
+
+public:
+    explicit ReferenceList(size_t = 0) {}
+
+    bool contains(int key) const { return std::find(keys.begin(), keys.end(), key) != keys.end(); }
+    bool empty() const { return keys.empty(); }
+    size_t size() const { return keys.size(); }
+    int front() const { return keys.empty() ? -1 : keys.front(); }
+
+    void push_back(int key) { keys.push_back(key); }
+    void remove(int key) { keys.erase(std::find(keys.begin(), keys.end(), key)); }
+
+    int pop_front() {
+        if (keys.empty()) return -1;
+        int key = keys.front();
+        keys.pop_front();
+        return key;
+    }
+
+    void move_to_back(int key) {
+        remove(key);
+        push_back(key);
+    }
+
+    void save(Snapshot& snap) const { snap.put(std::vector<int>(keys.begin(), keys.end())); }
+
+    void load(Snapshot& snap) {
+        std::vector<int> order;
+        snap.get(order);
+        keys.assign(order.begin(), order.end());
+    }
 };
 
 // First-in-first-out (FIFO) page replacement algorithm implementation
-class FIFOPager : public Pager {
+class FIFOPager final : public Pager {
 protected:
     int current_index;
 
 public:
     FIFOPager() : current_index(0) {}
 
-    frame_t* select_victim_frame(std::vector<frame_t>& frame_table, std::vector<Process>& processes, unsigned long inst_count) override {
-        frame_t* victim_frame = &frame_table[current_index];
-        current_index = (current_index + 1) % frame_table.size();
+    frame_t* select_victim_frame(std::vector<frame_t*>& frames, std::vector<Process>& processes, unsigned long inst_count) override {
+        if (current_index >= frames.size()) {
+            current_index = 0;
+        }
+        frame_t* victim_frame = frames[current_index];
+        current_index = (current_index + 1) % frames.size();
         return victim_frame;
     }
+
+    void save(Snapshot& snap) const override { snap.put(current_index); }
+    void load(Snapshot& snap) override { snap.get(current_index); }
 };
 
 // Clock page replacement algorithm implementation
-class ClockPager : public Pager {
+class ClockPager final : public Pager {
 private:
     int currentIndex;
     std::vector<frame_t>& frameTable;
@@ -185,47 +705,50 @@ private:
 public:
     ClockPager(std::vector<frame_t>& frames) : frameTable(frames), currentIndex(0) {}
 
-    frame_t* select_victim_frame(std::vector<frame_t>& frame_table, std::vector<Process>& processes, unsigned long inst_count) override {
+    frame_t* select_victim_frame(std::vector<frame_t*>& frames, std::vector<Process>& processes, unsigned long inst_count) override {
     
-        if (currentIndex >= frame_table.size()) {
+        if (currentIndex >= frames.size()) {
             currentIndex = 0;
         }
 
         while (true) {
-            frame_t* candidate = &frame_table[currentIndex];
+            frame_t* candidate = frames[currentIndex];
             pte_t& pte = processes[candidate->process_id].page_table[candidate->virtual_page];
 
             // Check if this frame can be used as a victim
             if (!pte.referenced) {
-                currentIndex = (currentIndex + 1) % frame_table.size();  // Move hand for next use
+                currentIndex = (currentIndex + 1) % frames.size();  // Move hand for next use
                 return candidate;
             }
 
             // Reset the referenced bit and move the clock hand
             pte.referenced = 0;
-            currentIndex = (currentIndex + 1) % frame_table.size();
+            currentIndex = (currentIndex + 1) % frames.size();
         }
 
         // Should not reach here
         return nullptr;
     }
+
+    void save(Snapshot& snap) const override { snap.put(currentIndex); }
+    void load(Snapshot& snap) override { snap.get(currentIndex); }
 };
 
 // Random page replacement algorithm implementation
-class RandomPager : public Pager {
+class RandomPager final : public Pager {
 public:
     RandomPager() {}
 
-    frame_t* select_victim_frame(std::vector<frame_t>& frame_table, std::vector<Process>& processes, unsigned long inst_count) override {
-        if (frame_table.empty()) return nullptr; // Safety check
+    frame_t* select_victim_frame(std::vector<frame_t*>& frames, std::vector<Process>& processes, unsigned long inst_count) override {
+        if (frames.empty()) return nullptr; // Safety check
 
-        int randomIndex = myrandom(frame_table.size()) - 1; // myrandom returns 1-based index
-        return &frame_table[randomIndex];
+        int randomIndex = myrandom(frames.size()) - 1; // myrandom returns 1-based index
+        return frames[randomIndex];
     }
 };
 
 // Aging page replacement algorithm implementation
-class AgingPager : public Pager {
+class AgingPager final : public Pager {
 private:
     std::vector<frame_t>& frameTable;
     int current_index;
@@ -233,9 +756,10 @@ private:
 public:
     AgingPager(std::vector<frame_t>& frames) : frameTable(frames), current_index(0) {}
 
-    frame_t* select_victim_frame(std::vector<frame_t>& frame_table, std::vector<Process>& processes, unsigned long inst_count) override {
+    frame_t* select_victim_frame(std::vector<frame_t*>& frames, std::vector<Process>& processes, unsigned long inst_count) override {
         // Age all frames: right-shift and set the highest bit if referenced
-        for (auto& frame : frame_table) {
+        for (frame_t* f : frames) {
+            frame_t& frame = *f;
             if (frame.process_id != -1) { // Only age frames that are in use
                 frame.age >>= 1; // Right shift the age
                 pte_t& pte = processes[frame.process_id].page_table[frame.virtual_page];
@@ -247,41 +771,47 @@ public:
         }
 
         // Find the frame with the smallest age (the oldest frame)
+        if (current_index >= frames.size()) {
+            current_index = 0;
+        }
         int victim_index = current_index;
-        for (int i = 0; i < frame_table.size(); ++i) {
-            int idx = (current_index + i) % frame_table.size();
-            if (frame_table[idx].age < frame_table[victim_index].age) {
+        for (int i = 0; i < frames.size(); ++i) {
+            int idx = (current_index + i) % frames.size();
+            if (frames[idx]->age < frames[victim_index]->age) {
                 victim_index = idx;
             }
         }
 
         // Reset the age of the victim frame and update current_index
-        frame_table[victim_index].age = 0;
-        current_index = (victim_index + 1) % frame_table.size();
+        frames[victim_index]->age = 0;
+        current_index = (victim_index + 1) % frames.size();
 
-        return &frame_table[victim_index];
+        return frames[victim_index];
     }
+
+    void save(Snapshot& snap) const override { snap.put(current_index); }
+    void load(Snapshot& snap) override { snap.get(current_index); }
 };
 
 // Working Set page replacement algorithm implementation
-class WorkingSetPager : public Pager {
+class WorkingSetPager final : public Pager {
 private:
     std::vector<frame_t>& frameTable;
     std::vector<Process>& processes;
     int hand;  // Index to start scanning from
-    const int TAU = 49;  // Time threshold for the working set
 
 public:
     WorkingSetPager(std::vector<frame_t>& frames, std::vector<Process>& proc)
         : frameTable(frames), processes(proc), hand(0) {}
 
-    frame_t* select_victim_frame(std::vector<frame_t>& frame_table, std::vector<Process>& processes, unsigned long inst_count) {
+    frame_t* select_victim_frame(std::vector<frame_t*>& frames, std::vector<Process>& processes, unsigned long inst_count) override {
         frame_t* victim = nullptr;
+        int victimIndex = -1;
         int minAge = -1;  // Initialize tonegative number
 
-        for (int i = 0; i < frame_table.size(); ++i) {
-            int idx = (hand + i) % frame_table.size();
-            frame_t& frame = frame_table[idx];
+        for (int i = 0; i < frames.size(); ++i) {
+            int idx = (hand + i) % frames.size();
+            frame_t& frame = *frames[idx];
             pte_t& pte = processes[frame.process_id].page_table[frame.virtual_page];
             
             if (pte.referenced) {
@@ -294,25 +824,30 @@ public:
             // std::cout<< "TEMP AGE: "<<temp_age<<std::endl;
 
             
-            if (temp_age > TAU) {
+            if (temp_age > (int)TAU) {  // Time threshold for the working set
                 victim = &frame;
-                hand = (idx + 1) % frame_table.size();
+                hand = (idx + 1) % frames.size();
                 return victim;  // Found a frame old enough to be evicted
             } else if (temp_age > minAge) {
                 minAge = temp_age;
                 victim = &frame;
+                victimIndex = idx;
             }
         }
         // If all frames were referenced within TAU, evict the least recently used
         if (!victim) {
-            victim = &frame_table[hand];
+            victimIndex = hand % frames.size();
+            victim = frames[victimIndex];
         }
-        hand = (victim - &frame_table[0] + 1) % frame_table.size();
+        hand = (victimIndex + 1) % frames.size();
         return victim;
     }
+
+    void save(Snapshot& snap) const override { snap.put(hand); }
+    void load(Snapshot& snap) override { snap.get(hand); }
 };
 
-class NRUPager : public Pager {
+class NRUPager final : public Pager {
 private:
     std::vector<frame_t>& frameTable;
     std::vector<Process>& processes;
@@ -323,7 +858,7 @@ public:
     NRUPager(std::vector<frame_t>& frames, std::vector<Process>& proc)
         : frameTable(frames), processes(proc), hand(0), lastReset(0) {}
 
-    frame_t* select_victim_frame(std::vector<frame_t>& frame_table, std::vector<Process>& processes, unsigned long inst_count) override {
+    frame_t* select_victim_frame(std::vector<frame_t*>& frames, std::vector<Process>& processes, unsigned long inst_count) override {
         const int RESET_INTERVAL = 48;  // Interval for resetting the REFERENCED bits
         bool reset = (inst_count - lastReset >= RESET_INTERVAL);
         int victimIndex = -1;
@@ -338,9 +873,9 @@ public:
         };
 
         // Scan through the frame table to classify frames
-        for (int i = 0; i < frame_table.size(); ++i) {
-            int idx = (hand + i) % frame_table.size();
-            frame_t& frame = frame_table[idx];
+        for (int i = 0; i < frames.size(); ++i) {
+            int idx = (hand + i) % frames.size();
+            frame_t& frame = *frames[idx];
             // if (frame.process_id != -1) {  // Only consider frames that are in use
                 pte_t& pte = processes[frame.process_id].page_table[frame.virtual_page];
                 
@@ -381,39 +916,933 @@ public:
         // }
 
         if (victimIndex != -1) {
-            hand = (victimIndex + 1) % numFrames; // Set hand for the next call
-            return &frame_table[victimIndex];
+            hand = (victimIndex + 1) % frames.size(); // Set hand for the next call
+            return frames[victimIndex];
         }
 
         return nullptr;  // No victim found (shouldn't happen if there are frames)
     }
+
+    void save(Snapshot& snap) const override {
+        snap.put(hand);
+        snap.put(lastReset);
+    }
+
+    void load(Snapshot& snap) override {
+        snap.get(hand);
+        snap.get(lastReset);
+    }
 };
 
+// Common base for the scan-resistant pagers below. They track pages by key
+// (see page_key) rather than by frame, so pages can outlive their frame as ghosts.
+// Their list type is a template parameter: PageList, or ReferenceList for -d.
+class KeyedPager : public Pager {
+protected:
+    std::vector<frame_t>& frameTable;
+    std::vector<Process>& processes;
+    size_t c;       // Cache size in frames
+    int pending;    // Key of the page faulting in this pager, -1 when the fault is
+                    // another pager's (-L: a donor giving up a frame)
 
-Pager* THE_PAGER;
+    KeyedPager(std::vector<frame_t>& frames, std::vector<Process>& proc, size_t capacity)
+        : frameTable(frames), processes(proc), c(capacity), pending(-1) {}
 
-// FIFOPager* THE_PAGER = new FIFOPager();
-// Pager* THE_PAGER = new FIFOPager();
-// Pager* THE_PAGER = new ClockPager(frame_table);
-// Pager* THE_PAGER = new RandomPager();
-// Pager* THE_PAGER = new AgingPager(frame_table);
-// Pager* THE_PAGER = new WorkingSetPager(frame_table, processes);
-// Pager* THE_PAGER = new NRUPager(frame_table, processes);
+    size_t num_keys() const { return processes.size() * NUM_VIRTUAL_PAGES; }
 
+    int key_of(const frame_t* frame) const {
+        return page_key(frame->process_id, frame->virtual_page);
+    }
+
+    frame_t* frame_of(int key) {
+        const pte_t& pte = processes[key / NUM_VIRTUAL_PAGES].page_table[key % NUM_VIRTUAL_PAGES];
+        return &frameTable[pte.frame_number];
+    }
+
+    template <class List>
+    bool pending_in(const List& list) const {
+        return pending != -1 && list.contains(pending);
+    }
+
+public:
+    void on_fault(int pid, int vpage) override {
+        pending = page_key(pid, vpage);
+    }
+
+    void on_map(frame_t* frame) override {
+        pending = -1;
+    }
+
+    void save(Snapshot& snap) const override { snap.put(pending); }
+    void load(Snapshot& snap) override { snap.get(pending); }
+};
+
+// Adaptive Replacement Cache (Megiddo & Modha). T1/T2 hold resident pages seen
+// once/more than once, B1/B2 remember pages recently evicted from each.
+template <class List>
+class ARCPagerT final : public KeyedPager {
+private:
+    List T1, T2, B1, B2;
+    size_t p;  // Adaptive target size of T1
+
+    frame_t* replace(bool inB2) {
+        int key;
+        if (!T1.empty() && (T1.size() > p || (inB2 && T1.size() == p) || T2.empty())) {
+            key = T1.pop_front();
+            B1.push_back(key);
+        } else {
+            key = T2.pop_front();
+            B2.push_back(key);
+        }
+        return frame_of(key);
+    }
+
+public:
+    ARCPagerT(std::vector<frame_t>& frames, std::vector<Process>& proc, size_t capacity)
+        : KeyedPager(frames, proc, capacity), T1(num_keys()), T2(num_keys()), B1(num_keys()), B2(num_keys()), p(0) {}
+
+    void on_fault(int pid, int vpage) override {
+        KeyedPager::on_fault(pid, vpage);
+        // A ghost hit tells us which list was evicted too eagerly
+        if (B1.contains(pending)) {
+            p = std::min(c, p + std::max<size_t>(B2.size() / B1.size(), 1));
+        } else if (B2.contains(pending)) {
+            p -= std::min(p, std::max<size_t>(B1.size() / B2.size(), 1));
+        }
+    }
+
+    frame_t* select_victim_frame(std::vector<frame_t*>& frames, std::vector<Process>& processes, unsigned long inst_count) override {
+        bool ghost = pending_in(B1) || pending_in(B2);
+        if (!ghost && T1.size() + B1.size() >= c) {
+            if (T1.size() >= c) {
+                return frame_of(T1.pop_front());  // B1 is empty: drop the LRU page outright
+            }
+            B1.pop_front();
+        } else if (!ghost && T1.size() + T2.size() + B1.size() + B2.size() >= 2 * c) {
+            B2.pop_front();
+        }
+        return replace(pending_in(B2));
+    }
+
+    void on_map(frame_t* frame) override {
+        KeyedPager::on_map(frame);
+        int key = key_of(frame);
+        if (B1.contains(key) || B2.contains(key)) {
+            if (B1.contains(key)) B1.remove(key); else B2.remove(key);
+            T2.push_back(key);
+        } else {
+            T1.push_back(key);
+        }
+        // Keep the directory bounded when pages are mapped into free frames
+        while (T1.size() + B1.size() > c && !B1.empty()) B1.pop_front();
+        while (T1.size() + T2.size() + B1.size() + B2.size() > 2 * c && !B2.empty()) B2.pop_front();
+    }
+
+    void on_reference(frame_t* frame) override {
+        int key = key_of(frame);
+        if (T1.contains(key)) {
+            T1.remove(key);
+            T2.push_back(key);
+        } else if (T2.contains(key)) {
+            T2.move_to_back(key);
+        }
+    }
+
+    void on_unmap(frame_t* frame) override {
+        int key = key_of(frame);
+        if (T1.contains(key)) T1.remove(key);
+        else if (T2.contains(key)) T2.remove(key);
+    }
+
+    void save(Snapshot& snap) const override {
+        KeyedPager::save(snap);
+        T1.save(snap); T2.save(snap); B1.save(snap); B2.save(snap);
+        snap.put(p);
+    }
+
+    void load(Snapshot& snap) override {
+        KeyedPager::load(snap);
+        T1.load(snap); T2.load(snap); B1.load(snap); B2.load(snap);
+        snap.get(p);
+    }
+};
+
+using ARCPager = ARCPagerT<PageList>;
+
+// Clock with Adaptive Replacement (Bansal & Modha). Same lists as ARC, but T1/T2
+// are clocks whose heads are the hands, so a hit only sets a reference bit.
+template <class List>
+class CARPagerT final : public KeyedPager {
+private:
+    List T1, T2, B1, B2;
+    std::vector<char> ref;  // Per-page reference bit, set on hits only
+    size_t p;               // Adaptive target size of T1
+
+    int replace() {
+        while (true) {
+            if (T2.empty() || (!T1.empty() && T1.size() >= std::max<size_t>(1, p))) {
+                int key = T1.pop_front();
+                if (!ref[key]) {
+                    B1.push_back(key);
+                    return key;
+                }
+                ref[key] = 0;
+                T2.push_back(key);
+            } else {
+                int key = T2.front();
+                if (!ref[key]) {
+                    T2.pop_front();
+                    B2.push_back(key);
+                    return key;
+                }
+                ref[key] = 0;
+                T2.move_to_back(key);
+            }
+        }
+    }
+
+public:
+    CARPagerT(std::vector<frame_t>& frames, std::vector<Process>& proc, size_t capacity)
+        : KeyedPager(frames, proc, capacity), T1(num_keys()), T2(num_keys()), B1(num_keys()), B2(num_keys()),
+          ref(num_keys(), 0), p(0) {}
+
+    frame_t* select_victim_frame(std::vector<frame_t*>& frames, std::vector<Process>& processes, unsigned long inst_count) override {
+        frame_t* victim = frame_of(replace());
+        if (!pending_in(B1) && !pending_in(B2)) {
+            if (T1.size() + B1.size() >= c) {
+                B1.pop_front();
+            } else if (T1.size() + T2.size() + B1.size() + B2.size() >= 2 * c) {
+                B2.pop_front();
+            }
+        }
+        return victim;
+    }
+
+    void on_map(frame_t* frame) override {
+        KeyedPager::on_map(frame);
+        int key = key_of(frame);
+        if (B1.contains(key)) {
+            p = std::min(c, p + std::max<size_t>(B2.size() / B1.size(), 1));
+            B1.remove(key);
+            T2.push_back(key);
+        } else if (B2.contains(key)) {
+            p -= std::min(p, std::max<size_t>(B1.size() / B2.size(), 1));
+            B2.remove(key);
+            T2.push_back(key);
+        } else {
+            T1.push_back(key);
+        }
+        ref[key] = 0;
+        while (T1.size() + B1.size() > c && !B1.empty()) B1.pop_front();
+        while (T1.size() + T2.size() + B1.size() + B2.size() > 2 * c && !B2.empty()) B2.pop_front();
+    }
+
+    void on_reference(frame_t* frame) override {
+        ref[key_of(frame)] = 1;
+    }
+
+    void on_unmap(frame_t* frame) override {
+        int key = key_of(frame);
+        if (T1.contains(key)) T1.remove(key);
+        else if (T2.contains(key)) T2.remove(key);
+    }
+
+    void save(Snapshot& snap) const override {
+        KeyedPager::save(snap);
+        T1.save(snap); T2.save(snap); B1.save(snap); B2.save(snap);
+        snap.put(ref);
+        snap.put(p);
+    }
+
+    void load(Snapshot& snap) override {
+        KeyedPager::load(snap);
+        T1.load(snap); T2.load(snap); B1.load(snap); B2.load(snap);
+        snap.get(ref);
+        snap.get(p);
+    }
+};
+
+using CARPager = CARPagerT<PageList>;
+
+// Full 2Q (Johnson & Shasha). New pages enter the A1in FIFO; only pages that
+// come back while remembered in A1out are promoted to the Am LRU list.
+template <class List>
+class TwoQPagerT final : public KeyedPager {
+private:
+    List A1in, A1out, Am;
+    size_t Kin;   // Target size of A1in (25% of frames)
+    size_t Kout;  // Capacity of A1out (50% of frames)
+
+public:
+    TwoQPagerT(std::vector<frame_t>& frames, std::vector<Process>& proc, size_t capacity)
+        : KeyedPager(frames, proc, capacity), A1in(num_keys()), A1out(num_keys()), Am(num_keys()),
+          Kin(std::max<size_t>(1, capacity / 4)), Kout(std::max<size_t>(1, capacity / 2)) {}
+
+    frame_t* select_victim_frame(std::vector<frame_t*>& frames, std::vector<Process>& processes, unsigned long inst_count) override {
+        int key;
+        if (A1in.size() > Kin || Am.empty()) {
+            key = A1in.pop_front();
+            A1out.push_back(key);
+            if (A1out.size() > Kout) A1out.pop_front();
+        } else {
+            key = Am.pop_front();
+        }
+        return frame_of(key);
+    }
+
+    void on_map(frame_t* frame) override {
+        KeyedPager::on_map(frame);
+        int key = key_of(frame);
+        if (A1out.contains(key)) {
+            A1out.remove(key);
+            Am.push_back(key);
+        } else {
+            A1in.push_back(key);
+        }
+    }
+
+    void on_reference(frame_t* frame) override {
+        int key = key_of(frame);
+        if (Am.contains(key)) Am.move_to_back(key);
+    }
+
+    void on_unmap(frame_t* frame) override {
+        int key = key_of(frame);
+        if (A1in.contains(key)) A1in.remove(key);
+        else if (Am.contains(key)) Am.remove(key);
+    }
+
+    void save(Snapshot& snap) const override {
+        KeyedPager::save(snap);
+        A1in.save(snap); A1out.save(snap); Am.save(snap);
+    }
+
+    void load(Snapshot& snap) override {
+        KeyedPager::load(snap);
+        A1in.load(snap); A1out.load(snap); Am.load(snap);
+    }
+};
+
+using TwoQPager = TwoQPagerT<PageList>;
+
+// Low Inter-reference Recency Set (Jiang & Zhang). S is the recency stack
+// (bottom = front) holding LIR pages and recently seen HIR pages, resident or
+// not; Q holds the resident HIR pages, which are the only eviction candidates.
+template <class List>
+class LIRSPagerT final : public KeyedPager {
+private:
+    enum State : char { NONE, LIR, HIR_RES, HIR_NONRES };
+
+    List S, Q;
+    std::vector<char> state;
+    size_t lirCount;
+    size_t Llirs;  // LIR capacity: all frames but ~1% reserved for HIR pages
+
+    // Remove HIR pages from the bottom of S so that it always ends in a LIR page
+    void prune() {
+        while (!S.empty() && state[S.front()] != LIR) {
+            int key = S.pop_front();
+            if (state[key] == HIR_NONRES) state[key] = NONE;
+        }
+    }
+
+    void demote_bottom_lir() {
+        prune();
+        int key = S.pop_front();
+        state[key] = HIR_RES;
+        Q.push_back(key);
+        lirCount--;
+        prune();
+    }
+
+public:
+    LIRSPagerT(std::vector<frame_t>& frames, std::vector<Process>& proc, size_t capacity)
+        : KeyedPager(frames, proc, capacity), S(num_keys()), Q(num_keys()), state(num_keys(), NONE), lirCount(0) {
+        size_t Lhirs = std::max<size_t>(1, c / 100);
+        Llirs = c > Lhirs ? c - Lhirs : 0;
+    }
+
+    frame_t* select_victim_frame(std::vector<frame_t*>& frames, std::vector<Process>& processes, unsigned long inst_count) override {
+        int key;
+        if (!Q.empty()) {
+            key = Q.pop_front();
+            state[key] = S.contains(key) ? HIR_NONRES : NONE;
+        } else {
+            // Only LIR pages are resident: fall back to the least recent one
+            prune();
+            key = S.pop_front();
+            state[key] = NONE;
+            lirCount--;
+            prune();
+        }
+        return frame_of(key);
+    }
+
+    void on_map(frame_t* frame) override {
+        KeyedPager::on_map(frame);
+        int key = key_of(frame);
+        if (state[key] == HIR_NONRES) {
+            // Re-referenced within the LIR recency: promote and demote the bottom LIR
+            S.move_to_back(key);
+            state[key] = LIR;
+            lirCount++;
+            while (lirCount > Llirs) demote_bottom_lir();
+        } else if (lirCount < Llirs) {
+            state[key] = LIR;
+            lirCount++;
+            S.push_back(key);
+        } else {
+            state[key] = HIR_RES;
+            S.push_back(key);
+            Q.push_back(key);
+        }
+    }
+
+    void on_reference(frame_t* frame) override {
+        int key = key_of(frame);
+        if (state[key] == LIR) {
+            bool bottom = S.front() == key;
+            S.move_to_back(key);
+            if (bottom) prune();
+        } else if (state[key] == HIR_RES) {
+            if (S.contains(key)) {
+                S.move_to_back(key);
+                Q.remove(key);
+                state[key] = LIR;
+                lirCount++;
+                while (lirCount > Llirs) demote_bottom_lir();
+            } else {
+                S.push_back(key);
+                Q.move_to_back(key);
+            }
+        }
+    }
+
+    void on_unmap(frame_t* frame) override {
+        int key = key_of(frame);
+        if (state[key] == LIR) lirCount--;
+        if (Q.contains(key)) Q.remove(key);
+        if (S.contains(key)) S.remove(key);
+        state[key] = NONE;
+        prune();
+    }
+
+    void save(Snapshot& snap) const override {
+        KeyedPager::save(snap);
+        S.save(snap); Q.save(snap);
+        snap.put(state);
+        snap.put(lirCount);
+    }
+
+    void load(Snapshot& snap) override {
+        KeyedPager::load(snap);
+        S.load(snap); Q.load(snap);
+        snap.get(state);
+        snap.get(lirCount);
+    }
+};
+
+using LIRSPager = LIRSPagerT<PageList>;
+
+
+// Per-phase cycle accounting for -oT. Timers are a template flag of the
+// simulation loop, so they cost nothing unless requested.
+enum Phase { PHASE_PARSE, PHASE_VICTIM, PHASE_FAULT, PHASE_OUTPUT, NUM_PHASES };
+const char* const PHASE_NAMES[NUM_PHASES] = { "parse", "victim", "fault", "output" };
+unsigned long long phase_cycles[NUM_PHASES] = {};
+unsigned long phase_calls[NUM_PHASES] = {};
+unsigned long long sim_cycles = 0;  // Whole simulate() run
+
+inline unsigned long long read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// Adds the cycles spent in its scope to a phase
+template <bool Timed>
+class PhaseTimer {
+private:
+    Phase phase;
+    unsigned long long start;
+
+public:
+    explicit PhaseTimer(Phase p) : phase(p), start(Timed ? read_cycles() : 0) {}
+
+    ~PhaseTimer() {
+        if constexpr (Timed) {
+            phase_cycles[phase] += read_cycles() - start;
+            phase_calls[phase]++;
+        }
+    }
+};
+
+// Hardware counters for the whole simulation, read with a single
+// perf_event_open group. Counters the kernel refuses are reported as n/a.
+class HwCounters {
+public:
+    enum { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, NUM_COUNTERS };
+
+    bool available = false;
+    std::string error;                       // Why counting is unavailable
+    bool opened[NUM_COUNTERS] = {};
+    unsigned long long values[NUM_COUNTERS] = {};
+
+private:
+    int fds[NUM_COUNTERS] = { -1, -1, -1, -1 };
+    int leader = -1;
+
+public:
+    void start() {
+#ifdef __linux__
+        const unsigned long long configs[NUM_COUNTERS] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+        for (int i = 0; i < NUM_COUNTERS; ++i) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.disabled = (leader == -1);
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+            fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+            if (fds[i] == -1 && leader == -1) {
+                error = std::string("perf_event_open: ") + strerror(errno);
+                continue;  // Try the next event as group leader
+            }
+            opened[i] = fds[i] != -1;
+            if (opened[i] && leader == -1) leader = fds[i];
+        }
+        if (leader == -1) return;
+        available = true;
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+        error = "perf_event_open is Linux only";
+#endif
+    }
+
+    void stop() {
+#ifdef __linux__
+        if (!available) return;
+        ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        // Group read: nr, then {value, id} per opened event in creation order
+        unsigned long long buffer[1 + 2 * NUM_COUNTERS];
+        if (read(leader, buffer, sizeof(buffer)) > 0) {
+            for (int i = 0, slot = 0; i < NUM_COUNTERS; ++i) {
+                if (opened[i]) values[i] = buffer[1 + 2 * slot++];
+            }
+        }
+        for (int fd : fds) {
+            if (fd != -1) close(fd);
+        }
+#endif
+    }
+};
+
+HwCounters hw_counters;
+
+
+// Log-linear histogram in the style of HdrHistogram: values below 32 get
+// their own bucket, larger ones land in one of 16 sub-buckets of their
+// power of two (about 6% relative precision). All buckets are allocated
+// up front, so recording is an index computation and an increment.
+class CostHistogram {
+public:
+    static const int SUB_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int NUM_BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;  // bucket_of(ULLONG_MAX) is the last
+
+private:
+    unsigned long counts[NUM_BUCKETS] = {};
+    unsigned long total = 0;
+    unsigned long long sum = 0;
+    unsigned long long min_value = ULLONG_MAX;
+    unsigned long long max_value = 0;
+
+    static int bucket_of(unsigned long long value) {
+        if (value < 2 * SUB_BUCKETS) return value;
+        int shift = 63 - __builtin_clzll(value) - SUB_BITS;
+        return shift * SUB_BUCKETS + (value >> shift);
+    }
+
+    static unsigned long long lowest_in(int bucket) {
+        if (bucket < 2 * SUB_BUCKETS) return bucket;
+        int shift = bucket / SUB_BUCKETS - 1;
+        return (unsigned long long)(bucket - shift * SUB_BUCKETS) << shift;
+    }
+
+    static unsigned long long highest_in(int bucket) {
+        return bucket + 1 < NUM_BUCKETS ? lowest_in(bucket + 1) - 1 : ULLONG_MAX;
+    }
+
+    // Upper bound of the bucket holding the given percentile, capped by the maximum
+    unsigned long long percentile(double pct) const {
+        unsigned long rank = (unsigned long)(pct / 100.0 * total + 0.5);
+        if (rank < 1) rank = 1;
+        unsigned long seen = 0;
+        for (int i = 0; i < NUM_BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen >= rank) return std::min(highest_in(i), max_value);
+        }
+        return max_value;
+    }
+
+public:
+    void record(unsigned long long value) {
+        counts[bucket_of(value)]++;
+        total++;
+        sum += value;
+        min_value = std::min(min_value, value);
+        max_value = std::max(max_value, value);
+    }
+
+    void print(const char* name) const {
+        if (!total) {
+            printf("%s: count=0\n", name);
+            return;
+        }
+        printf("%s: count=%lu min=%llu mean=%.1f p50=%llu p90=%llu p99=%llu p999=%llu max=%llu\n",
+               name, total, min_value, (double)sum / total, percentile(50), percentile(90),
+               percentile(99), percentile(99.9), max_value);
+        for (int i = 0; i < NUM_BUCKETS; ++i) {
+            if (counts[i]) printf("%s[%llu-%llu]: %lu\n", name, lowest_in(i), std::min(highest_in(i), max_value), counts[i]);
+        }
+    }
+};
+
+// -oH: cost of every page fault, including unmapping and writing back the victim
+bool record_fault_cost = false;
+CostHistogram fault_costs;
+
+// -w<N>: counters every N instructions. Each window end stores a snapshot of
+// the cumulative counters in a ring preallocated at startup; deltas are only
+// computed when the ring is drained (when it is full and after the run), so
+// the simulation loop does a comparison per instruction and a copy per window.
+class WindowSeries {
+public:
+    static const size_t SLOTS = 256;
+
+private:
+    struct Totals {
+        unsigned long inst = 0;
+        unsigned long rwcount = 0;
+        unsigned long ctx_switches = 0;
+        unsigned long process_exits = 0;
+    };
+
+    size_t num_procs = 0;
+    std::vector<Totals> totals;           // SLOTS snapshots
+    std::vector<ProcessStats> stats;      // SLOTS * num_procs snapshots
+    size_t head = 0, used = 0;
+    Totals last_totals;                   // Last drained snapshot
+    std::vector<ProcessStats> last_stats;
+
+    static unsigned long long window_cost(const ProcessStats& now, const ProcessStats& before) {
+        return now.computeTotalCost() - before.computeTotalCost();
+    }
+
+public:
+    unsigned long size = 0;               // Instructions per window (0 = off)
+    unsigned long next_end = 0;
+
+    // Counters at the start of the first window (not zero for a restored run)
+    void init(unsigned long window, const std::vector<Process>& processes, unsigned long inst, unsigned long rwcount,
+              unsigned long ctx_switches, unsigned long process_exits) {
+        size = window;
+        next_end = (inst / window + 1) * window;
+        num_procs = processes.size();
+        totals.assign(SLOTS, Totals());
+        stats.assign(SLOTS * num_procs, ProcessStats());
+        last_totals = { inst, rwcount, ctx_switches, process_exits };
+        last_stats.clear();
+        for (const auto& proc : processes) last_stats.push_back(proc.stats);
+    }
+
+    void record(const std::vector<Process>& processes, unsigned long inst, unsigned long rwcount,
+                unsigned long ctx_switches, unsigned long process_exits) {
+        if (used == SLOTS) drain();
+        size_t slot = (head + used) % SLOTS;
+        totals[slot] = { inst, rwcount, ctx_switches, process_exits };
+        for (size_t p = 0; p < num_procs; ++p) {
+            stats[slot * num_procs + p] = processes[p].stats;
+        }
+        used++;
+    }
+
+    void drain() {
+        for (; used; head = (head + 1) % SLOTS, used--) {
+            const Totals& now = totals[head];
+            ProcessStats sum;
+            unsigned long long cost = 0;
+            for (size_t p = 0; p < num_procs; ++p) {
+                const ProcessStats& s = stats[head * num_procs + p];
+                const ProcessStats& b = last_stats[p];
+                unsigned long long proc_cost = window_cost(s, b);
+                printf("WINDOW[%lu-%lu] PROC[%zu]: faults=%lu ins=%lu outs=%lu fins=%lu fouts=%lu zeros=%lu segv=%lu cost=%llu\n",
+                       last_totals.inst, now.inst, p, s.maps - b.maps, s.ins - b.ins, s.outs - b.outs,
+                       s.fins - b.fins, s.fouts - b.fouts, s.zeros - b.zeros, s.segv - b.segv, proc_cost);
+                sum.maps += s.maps - b.maps;
+                sum.ins += s.ins - b.ins;
+                sum.outs += s.outs - b.outs;
+                sum.fins += s.fins - b.fins;
+                sum.fouts += s.fouts - b.fouts;
+                sum.zeros += s.zeros - b.zeros;
+                sum.segv += s.segv - b.segv;
+                cost += proc_cost;
+                last_stats[p] = s;
+            }
+            // Same cost model as TOTALCOST
+            cost += (now.rwcount - last_totals.rwcount) + (now.ctx_switches - last_totals.ctx_switches) * 130 +
+                    (now.process_exits - last_totals.process_exits) * 1230;
+            printf("WINDOW[%lu-%lu] TOTAL: faults=%lu ins=%lu outs=%lu fins=%lu fouts=%lu zeros=%lu segv=%lu cost=%llu\n",
+                   last_totals.inst, now.inst, sum.maps, sum.ins, sum.outs, sum.fins, sum.fouts,
+                   sum.zeros, sum.segv, cost);
+            last_totals = now;
+        }
+    }
+};
+
+WindowSeries windows;
+
+
+std::vector<frame_t*> all_frames;  // Replacement domain of the pager (global replacement)
+
+// Victim selections so far, for the lockstep comparison of -d
+struct VictimLog {
+    unsigned long count = 0;
+    frame_t* frame = nullptr;          // Last victim
+    unsigned long first = ULONG_MAX;   // Earliest instruction with a selection since -d last reset it
+};
+VictimLog victims;
+
+// Local replacement (-L): every process owns a frame list and a pager of its own
+bool local_replacement = false;
+unsigned long quota_adjust_interval = 0;  // Instructions between working-set quota adjustments (0 = off)
+unsigned long next_quota_adjust = 0;
+unsigned int ws_epoch = 1;
+
+
+// All pager types; main() dispatches on the alternative once for the whole run
+using PagerVariant = std::variant<std::monostate, FIFOPager, ClockPager, RandomPager, AgingPager, WorkingSetPager,
+                                  NRUPager, ARCPager, CARPager, TwoQPager, LIRSPager>;
+
+// Instantiate a pager in place; capacity is only used by the ghost-list pagers.
+// Returns false (leaving std::monostate) for an unknown algorithm.
+bool emplace_pager(PagerVariant& pager, const std::string& algorithm, std::vector<frame_t>& frame_table, std::vector<Process>& processes, size_t capacity) {
+    if (algorithm == "a") pager.emplace<AgingPager>(frame_table);
+    else if (algorithm == "c") pager.emplace<ClockPager>(frame_table);
+    else if (algorithm == "e") pager.emplace<NRUPager>(frame_table, processes);
+    else if (algorithm == "f") pager.emplace<FIFOPager>();
+    else if (algorithm == "r") pager.emplace<RandomPager>();
+    else if (algorithm == "w") pager.emplace<WorkingSetPager>(frame_table, processes);
+    else if (algorithm == "arc") pager.emplace<ARCPager>(frame_table, processes, capacity);
+    else if (algorithm == "car") pager.emplace<CARPager>(frame_table, processes, capacity);
+    else if (algorithm == "2q") pager.emplace<TwoQPager>(frame_table, processes, capacity);
+    else if (algorithm == "lirs") pager.emplace<LIRSPager>(frame_table, processes, capacity);
+    else return false;
+    return true;
+}
+
+// Heap-allocated pager, used for the per-process pagers of local replacement
+Pager* create_pager(const std::string& algorithm, std::vector<frame_t>& frame_table, std::vector<Process>& processes, size_t capacity) {
+    PagerVariant pager;
+    emplace_pager(pager, algorithm, frame_table, processes, capacity);
+    return std::visit([](auto& p) -> Pager* {
+        using PagerT = std::decay_t<decltype(p)>;
+        if constexpr (std::is_same_v<PagerT, std::monostate>) {
+            return nullptr;
+        } else {
+            return new PagerT(std::move(p));
+        }
+    }, pager);
+}
+
+// Pager of the reference run of -d: the ghost-list pagers over ReferenceList,
+// the others as they are (they have a single implementation)
+Pager* create_reference_pager(const std::string& algorithm, std::vector<frame_t>& frame_table, std::vector<Process>& processes, size_t capacity) {
+    if (algorithm == "arc") return new ARCPagerT<ReferenceList>(frame_table, processes, capacity);
+    if (algorithm == "car") return new CARPagerT<ReferenceList>(frame_table, processes, capacity);
+    if (algorithm == "2q") return new TwoQPagerT<ReferenceList>(frame_table, processes, capacity);
+    if (algorithm == "lirs") return new LIRSPagerT<ReferenceList>(frame_table, processes, capacity);
+    return create_pager(algorithm, frame_table, processes, capacity);
+}
+
+// Pager responsible for a process: its own one in local mode, the global one otherwise.
+// All pagers of a run have the same type, so the cast is exact.
+template <class PagerT>
+PagerT& pager_of(PagerT& global, Process& process) {
+    return local_replacement ? *static_cast<PagerT*>(process.pager) : global;
+}
+
+// Free frames still owed to other running processes that are below their reservation
+unsigned int reserved_for_others(const std::vector<Process>& processes, const Process& current) {
+    unsigned int owed = 0;
+    for (const auto& proc : processes) {
+        if (&proc != &current && !proc.exited && proc.frames.size() < proc.reserve) {
+            owed += proc.reserve - proc.frames.size();
+        }
+    }
+    return owed;
+}
+
+// Process to take a frame from: the one furthest above its quota, or if 'any'
+// is set and nobody is over quota, the one furthest above its reservation
+Process* pick_donor(std::vector<Process>& processes, const Process& current, bool any) {
+    Process* donor = nullptr;
+    long best = 0;
+    for (auto& proc : processes) {
+        long excess = (long)proc.frames.size() - proc.quota;
+        if (&proc != &current && excess > best) {
+            best = excess;
+            donor = &proc;
+        }
+    }
+    if (!donor && any) {
+        for (auto& proc : processes) {
+            long excess = (long)proc.frames.size() - proc.reserve;
+            if (&proc != &current && excess > best) {
+                best = excess;
+                donor = &proc;
+            }
+        }
+    }
+    return donor;
+}
+
+template <class PagerT>
+frame_t* select_victim(PagerT& pager, std::vector<frame_t*>& frames, std::vector<Process>& processes) {
+    frame_t* frame = pager.select_victim_frame(frames, processes, inst_count);
+    victims.count++;
+    victims.frame = frame;
+    victims.first = std::min(victims.first, inst_count - 1);  // Numbered as in -oO
+    return frame;
+}
+
+template <class PagerT>
+frame_t* take_frame_from(Process& donor, std::vector<Process>& processes) {
+    frame_t* frame = select_victim(*static_cast<PagerT*>(donor.pager), donor.frames, processes);
+    donor.frames.erase(std::find(donor.frames.begin(), donor.frames.end(), frame));
+    return frame;
+}
+
+template <class PagerT>
+frame_t* get_local_frame(std::vector<Process>& processes, Process& current) {
+    frame_t* frame = nullptr;
+    if (current.frames.size() < current.quota || current.frames.empty()) {
+        bool needy = current.frames.size() < current.reserve || current.frames.empty();
+        if (!free_frames.empty() && (free_frames.size() > reserved_for_others(processes, current) || current.frames.empty())) {
+            frame = free_frames.front();
+            free_frames.pop_front();
+        } else if (Process* donor = pick_donor(processes, current, needy)) {
+            frame = take_frame_from<PagerT>(*donor, processes);
+        }
+    }
+    if (!frame) {
+        if (!current.frames.empty()) {
+            // At quota: replace one of our own pages, ownership does not change
+            return select_victim(*static_cast<PagerT*>(current.pager), current.frames, processes);
+        }
+        // Owns nothing and every other process is within its reservation
+        Process* donor = nullptr;
+        for (auto& proc : processes) {
+            if (!donor || proc.frames.size() > donor->frames.size()) donor = &proc;
+        }
+        frame = take_frame_from<PagerT>(*donor, processes);
+    }
+    current.frames.push_back(frame);
+    return frame;
+}
 
-frame_t* get_frame(std::vector<frame_t>& frame_table, std::vector<Process>& processes) {
+template <class PagerT, bool Timed>
+frame_t* get_frame(PagerT& pager, std::vector<frame_t>& frame_table, std::vector<Process>& processes, Process& current_process) {
+    PhaseTimer<Timed> timer(PHASE_VICTIM);
+    if (local_replacement) {
+        return get_local_frame<PagerT>(processes, current_process);
+    }
     frame_t* frame;
     if (!free_frames.empty()) {
         frame = free_frames.front();
         free_frames.pop_front();
     } else {
-        frame = THE_PAGER->select_victim_frame(frame_table, processes, inst_count);
+        frame = select_victim(pager, all_frames, processes);
     }
     return frame;
 }
 
+// Redistribute the frames not covered by reservations in proportion to the
+// number of distinct pages each process touched since the last adjustment
+void adjust_quotas(std::vector<Process>& processes) {
+    unsigned long total_ws = 0;
+    unsigned int reserved = 0;
+    for (const auto& proc : processes) {
+        if (proc.exited) continue;
+        total_ws += proc.ws_size;
+        reserved += proc.reserve;
+    }
+    unsigned int spare = numFrames > reserved ? numFrames - reserved : 0;
+    if (total_ws > 0) {
+        for (auto& proc : processes) {
+            if (proc.exited) continue;
+            unsigned int share = proc.reserve + (unsigned int)(spare * proc.ws_size / total_ws);
+            if (proc.ws_size > 0 && share == 0) share = 1;
+            proc.quota = std::min(share, proc.max_quota);
+        }
+    }
+    for (auto& proc : processes) {
+        proc.ws_size = 0;
+    }
+    ws_epoch++;
+}
+
+// Quota file: '#' comments, "<pid> <quota> <reserve>" lines and an optional
+// "adjust <instructions>" line enabling working-set driven quota adjustment
+void load_quotas(const std::string& filename, std::vector<Process>& processes) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open quota file: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::string line;
+    unsigned int reserved = 0;
+    while (getline(file, line)) {
+        if (line.empty() || line[0] == '#' || std::all_of(line.begin(), line.end(), isspace)) {
+            continue;
+        }
+        std::istringstream iss(line);
+        if (line.compare(0, 6, "adjust") == 0) {
+            std::string keyword;
+            if (!(iss >> keyword >> quota_adjust_interval) || quota_adjust_interval == 0) {
+                std::cerr << "Invalid quota adjustment interval: " << line << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+        int pid;
+        unsigned int quota, reserve;
+        // A faulting process always gets a frame, so a quota is at least 1
+        if (!(iss >> pid >> quota >> reserve) || pid < 0 || pid >= (int)processes.size() || quota == 0 || reserve > quota) {
+            std::cerr << "Invalid quota line: " << line << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        processes[pid].quota = processes[pid].max_quota = quota;
+        processes[pid].reserve = reserve;
+        reserved += reserve;
+    }
+    if (reserved > (unsigned int)numFrames) {
+        std::cerr << "Frame reservations (" << reserved << ") exceed the number of frames\n";
+        exit(EXIT_FAILURE);
+    }
+    next_quota_adjust = quota_adjust_interval;
+}
+
 
-void load_processes(std::vector<Process>& processes, std::vector<frame_t>& frame_table, std::ifstream& file) {
+void load_processes(std::vector<Process>& processes, std::vector<frame_t>& frame_table, InputStream& file) {
     // std::ifstream file(filename);
     std::string line;
     
@@ -466,19 +1895,119 @@ void load_processes(std::vector<Process>& processes, std::vector<frame_t>& frame
 }
 
 
-bool get_next_instruction(std::ifstream& file, char& operation, int& vpage) {
+// One trace record. A run of references by the running process to the same
+// page is a single record with a repeat count (see InstructionReader).
+struct Instruction {
+    char op = 0;
+    int vpage = 0;
+    unsigned long count = 1;   // References in the run
+    unsigned long writes = 0;  // How many of them are writes
+};
+
+// "<op> <vpage> [<count>]": the optional count repeats the line that many
+// times. Returns false for lines that are not instructions.
+bool parse_instruction(const std::string& line, Instruction& ins) {
+    const char* p = line.c_str();
+    while (isspace(*p)) p++;
+    if (!*p) return false;
+    ins.op = *p++;
+    char* end;
+    long value = strtol(p, &end, 10);
+    if (end == p) return false;
+    ins.vpage = value;
+    p = end;
+    long count = strtol(p, &end, 10);
+    ins.count = (end != p && count > 0 && (ins.op == 'r' || ins.op == 'w')) ? count : 1;
+    ins.writes = ins.op == 'w' ? ins.count : 0;
+    return true;
+}
+
+// Reads instructions and merges consecutive references to the same page
+// (reads and writes alike) into one record, which simulate() applies at once.
+// Records read from the file are all reads or all writes; a record that does
+// not fit the limit is split and the rest is kept for the next call.
+class InstructionReader {
+private:
+    InputStream& file;
     std::string line;
-    while (getline(file, line)) {
-        if (!line.empty() && line[0] == '#') {
-            continue;
+    Instruction pending;
+    bool has_pending = false;
+
+    bool take(Instruction& ins) {
+        if (has_pending) {
+            ins = pending;
+            has_pending = false;
+            return true;
         }
-        std::istringstream iss(line);
-        if (iss >> operation >> vpage) {
-            return true; // Successfully parsed an instruction
+        while (getline(file, line)) {
+            if (!line.empty() && line[0] == '#') {
+                continue;
+            }
+            if (parse_instruction(line, ins)) {
+                return true; // Successfully parsed an instruction
+            }
         }
+        return false; // No more instructions
     }
-    return false; // No more instructions
-}
+
+    // Keep all but the first 'used' references of 'ins' for later
+    void keep(const Instruction& ins, unsigned long used) {
+        pending = ins;
+        pending.count -= used;
+        pending.writes = ins.writes ? pending.count : 0;
+        has_pending = true;
+    }
+
+    static bool is_reference(const Instruction& ins) {
+        return ins.op == 'r' || ins.op == 'w';
+    }
+
+public:
+    explicit InstructionReader(InputStream& in) : file(in) {}
+
+    // Next instruction, with runs of at most 'limit' references
+    bool next(Instruction& ins, unsigned long limit) {
+        if (!take(ins)) return false;
+        if (!is_reference(ins)) return true;
+        if (ins.count > limit) {
+            keep(ins, limit);
+            ins.count = limit;
+            ins.writes = ins.writes ? limit : 0;
+            return true;
+        }
+        Instruction next;
+        while (ins.count < limit && take(next)) {
+            if (!is_reference(next) || next.vpage != ins.vpage) {
+                keep(next, 0);
+                break;
+            }
+            unsigned long used = std::min(next.count, limit - ins.count);
+            ins.count += used;
+            ins.writes += next.writes ? used : 0;
+            if (used < next.count) {
+                keep(next, used);
+                break;
+            }
+        }
+        if (ins.writes) ins.op = 'w';
+        return true;
+    }
+
+    // Checkpoints: the position in the file and the record read ahead
+    void save(Snapshot& snap) const {
+        snap.put(file.tell());
+        snap.put(has_pending);
+        snap.put(pending);
+    }
+
+    void load(Snapshot& snap) {
+        unsigned long long offset;
+        snap.get(offset);
+        snap.get(has_pending);
+        snap.get(pending);
+        if (!file.skip_to(offset)) throw std::runtime_error("the trace ends before the checkpoint position");
+    }
+};
 
 // function to check if a virtual page is valid for the current process
 bool isValidPage(int vpage, const Process* proc) {
@@ -524,15 +2053,16 @@ void printFrameTable(const std::vector<frame_t>& frame_table) {
 }
 
 
+template <bool Trace>
 void out(frame_t* frame, Process& process) {
     pte_t& pte = process.page_table[frame->virtual_page];
     if (frame->dirty && frame->virtual_page != -1) {
         if (pte.file_mapped) {
-            if (o_flag) std::cout << " FOUT" << std::endl;
+            if constexpr (Trace) std::cout << " FOUT" << std::endl;
             process.stats.fouts ++;
 
         } else {
-            if (o_flag) std::cout << " OUT" << std::endl;
+            if constexpr (Trace) std::cout << " OUT" << std::endl;
             pte.paged_out = 1;
             process.stats.outs ++;
         }
@@ -542,13 +2072,14 @@ void out(frame_t* frame, Process& process) {
 
 bool exitloop = false;
 
+template <bool Trace>
 void unmap(frame_t* frame, Process& process) {
     if (frame->virtual_page != -1) {
         process.stats.unmaps ++;
         pte_t& pte = process.page_table[frame->virtual_page];
-        if (o_flag) std::cout << " UNMAP " << process.pid << ":" << frame->virtual_page << std::endl;
+        if constexpr (Trace) std::cout << " UNMAP " << process.pid << ":" << frame->virtual_page << std::endl;
         if (frame->dirty & !exitloop) {
-            out(frame, process);
+            out<Trace>(frame, process);
         }
         frame->process_id = -1;
         frame->virtual_page = -1;
@@ -560,12 +2091,13 @@ void unmap(frame_t* frame, Process& process) {
     }
 }
 
+template <bool Trace>
 void unmap2(frame_t* frame, Process& process) {
     if (frame->virtual_page != -1) {
         process.stats.unmaps ++;
 
         pte_t& pte = process.page_table[frame->virtual_page];
-        if (o_flag) std::cout << " UNMAP " << process.pid << ":" << frame->virtual_page << std::endl;
+        if constexpr (Trace) std::cout << " UNMAP " << process.pid << ":" << frame->virtual_page << std::endl;
         // if (frame->dirty & !exitloop) {
         //     out(frame, process);
         // }
@@ -574,7 +2106,7 @@ void unmap2(frame_t* frame, Process& process) {
     if (frame->dirty && frame->virtual_page != -1) {
         if (pte.file_mapped) {
 
-            if (o_flag) std::cout << " FOUT" << std::endl;
+            if constexpr (Trace) std::cout << " FOUT" << std::endl;
             process.stats.fouts ++;
         }
         frame->dirty = false;
@@ -590,6 +2122,7 @@ void unmap2(frame_t* frame, Process& process) {
 }
 
 
+template <bool Trace>
 void map(std::vector<frame_t>& frame_table, frame_t* frame, int vpage, Process& process) {
     pte_t& pte = process.page_table[vpage];
 
@@ -607,31 +2140,36 @@ void map(std::vector<frame_t>& frame_table, frame_t* frame, int vpage, Process&
 
     int frame_index = frame - &frame_table[0];
 
-    if (o_flag) std::cout << " MAP " << frame_index << std::endl;
+    if constexpr (Trace) std::cout << " MAP " << frame_index << std::endl;
 }
 
 
+template <bool Trace>
 void zero(frame_t* frame, Process& process) {
     // Assume frame has a method to clear its content
     frame->clear();
     process.stats.zeros ++;
-    if (o_flag) std::cout << " ZERO" << std::endl;
+    if constexpr (Trace) std::cout << " ZERO" << std::endl;
 }
 
+template <bool Trace>
 void in(frame_t* frame, int vpage, Process& process) {
     process.stats.ins ++;
-    if (o_flag) std::cout << " IN" << std::endl;
+    if constexpr (Trace) std::cout << " IN" << std::endl;
     frame->dirty = false; // Reset the dirty bit when a page is brought in
 }
 
+template <bool Trace>
 void fin(frame_t* frame, int vpage, Process& process) {
     process.stats.fins ++;
-    if (o_flag) std::cout << " FIN" << std::endl;
+    if constexpr (Trace) std::cout << " FIN" << std::endl;
     frame->dirty = false; // Reset the dirty bit when a page is brought in from a file
 }
 
 
-void handle_page_fault(std::vector<frame_t>& frame_table, std::vector<Process>& processes, Process& current_process, int vpage) {
+template <class PagerT, bool Trace, bool Timed>
+void handle_page_fault(PagerT& pager, std::vector<frame_t>& frame_table, std::vector<Process>& processes, Process& current_process, int vpage) {
+    PhaseTimer<Timed> timer(PHASE_FAULT);
     pte_t& pte = current_process.page_table[vpage];
     bool valid = false;
     for (const auto& vma : current_process.vmas) {
@@ -642,53 +2180,112 @@ void handle_page_fault(std::vector<frame_t>& frame_table, std::vector<Process>&
         }
     }
 
-    frame_t* frame = get_frame(frame_table, processes);
+    PagerT& owner_pager = pager_of(pager, current_process);
+    owner_pager.on_fault(current_process.pid, vpage);
+    unsigned long long cost_before = record_fault_cost ? current_process.stats.computeTotalCost() : 0;
+    Process* victim_owner = nullptr;
+    frame_t* frame = get_frame<PagerT, Timed>(pager, frame_table, processes, current_process);
     if (frame->process_id != -1 && frame->virtual_page != -1) {
         Process& owning_process = processes[frame->process_id];
-        unmap(frame, owning_process);
-        out(frame, owning_process);  // Handles OUT or FOUT depending on file_mapped
+        if (record_fault_cost && &owning_process != &current_process) {
+            victim_owner = &owning_process;
+            cost_before += owning_process.stats.computeTotalCost();
+        }
+        unmap<Trace>(frame, owning_process);
+        out<Trace>(frame, owning_process);  // Handles OUT or FOUT depending on file_mapped
         // std::cout<< "Yayyyyy"<<std::endl;
     }
 
     if (pte.file_mapped) {
-        fin(frame, vpage, current_process);
+        fin<Trace>(frame, vpage, current_process);
     } else if (pte.paged_out) {
-        in(frame, vpage, current_process);
+        in<Trace>(frame, vpage, current_process);
     } else {
-        zero(frame, current_process);
+        zero<Trace>(frame, current_process);
     }
 
-    map(frame_table, frame, vpage, current_process);
+    map<Trace>(frame_table, frame, vpage, current_process);
     pte.present = 1;
     pte.frame_number = static_cast<int>(frame - frame_table.data());
+    owner_pager.on_map(frame);
+    if (record_fault_cost) {
+        unsigned long long cost_after = current_process.stats.computeTotalCost() +
+                                        (victim_owner ? victim_owner->stats.computeTotalCost() : 0);
+        fault_costs.record(cost_after - cost_before);
+    }
 }
 
-void process_exit(Process& process, std::vector<frame_t>& frame_table) {
+template <class PagerT, bool Trace>
+void process_exit(PagerT& pager, Process& process, std::vector<frame_t>& frame_table) {
     exitloop = true;
-    if (o_flag) std::cout << "EXIT current process " << process.pid << std::endl;
+    process.exited = true;
+    if constexpr (Trace) std::cout << "EXIT current process " << process.pid << std::endl;
     for (auto& pte : process.page_table) {
         pte.paged_out = 0;
         if (pte.present) {
             frame_t* frame = &frame_table[pte.frame_number];
-            unmap2(frame, process);  // Ensure that frame is unmapped
+            pager_of(pager, process).on_unmap(frame);
+            unmap2<Trace>(frame, process);  // Ensure that frame is unmapped
             free_frames.push_back(frame);  // Return to free pool
             exitloop = false;
         }
     }
+    process.frames.clear();
 }
 
 unsigned long long cost = 0;
 unsigned long ctx_switches = 0, process_exits = 0;
 unsigned long rwcount = 0;
 // unsigned long index = 0;
+unsigned long pause_at = ULONG_MAX;  // simulate() returns before this instruction (checkpoints, branches)
+int current_pid = -1;                // Running process across simulate() calls
+
+// Instruction parsing, timed as its own phase under -oT
+template <bool Timed>
+bool next_instruction(InstructionReader& trace, Instruction& ins, unsigned long limit) {
+    PhaseTimer<Timed> timer(PHASE_PARSE);
+    return trace.next(ins, limit);
+}
 
-void simulate(std::vector<Process>& processes, std::vector<frame_t>& frame_table, std::ifstream& file) {
-    char command;
-    int vpage;
-    Process* currentProcess = nullptr;
+// Longest run of references simulate() may apply at once: runs end before the
+// next quota adjustment, window boundary and pause, so that those happen at
+// the same instruction as with one reference per record
+unsigned long run_limit() {
+    unsigned long limit = pause_at;
+    if (quota_adjust_interval) {
+        limit = std::min(limit, next_quota_adjust > inst_count ? next_quota_adjust : next_quota_adjust + quota_adjust_interval);
+    }
+    if (windows.size) {
+        limit = std::min(limit, windows.next_end > inst_count ? windows.next_end : windows.next_end + windows.size);
+    }
+    return limit - inst_count;
+}
 
-    while (get_next_instruction(file, command, vpage)) {
-        if (o_flag) std::cout << inst_count << ": ==> " << command << " " << vpage << std::endl;
+// The simulation loop is instantiated once per pager type, trace and timing
+// setting (see main), so pager calls are resolved statically and disabled
+// tracing/timing compiles away. Returns true if it stopped at pause_at
+// rather than at the end of the trace.
+template <class PagerT, bool Trace, bool Timed>
+bool simulate(PagerT& pager, std::vector<Process>& processes, std::vector<frame_t>& frame_table, InstructionReader& trace) {
+    Instruction ins;
+    Process* currentProcess = current_pid >= 0 ? &processes[current_pid] : nullptr;
+
+    // Traces show every reference, so runs are only merged without tracing
+    while (inst_count != pause_at && next_instruction<Timed>(trace, ins, Trace ? 1 : run_limit())) {
+        char command = ins.op;
+        int vpage = ins.vpage;
+        if (quota_adjust_interval && inst_count >= next_quota_adjust) {
+            adjust_quotas(processes);
+            next_quota_adjust += quota_adjust_interval;
+        }
+        if (windows.size && inst_count >= windows.next_end) {
+            windows.record(processes, inst_count, rwcount, ctx_switches, process_exits);
+            windows.next_end += windows.size;
+        }
+        if constexpr (Trace) {
+            PhaseTimer<Timed> timer(PHASE_OUTPUT);
+            std::cout << inst_count << ": ==> " << command << " " << vpage << std::endl;
+        }
         // index++;
         if (command == 'c') {
             inst_count ++;
@@ -702,39 +2299,554 @@ void simulate(std::vector<Process>& processes, std::vector<frame_t>& frame_table
         else if (command == 'e') {
             inst_count ++;
             if (currentProcess && vpage < processes.size() && vpage >= 0) {
-                process_exit(processes[vpage], frame_table); // Call the process exit function
+                process_exit<PagerT, Trace>(pager, processes[vpage], frame_table); // Call the process exit function
                 process_exits++;
                 // std::cout << "EXIT current process " << vpage << std::endl;
             }
         }
         
         else if (currentProcess && !isValidPage(vpage, currentProcess)) {
-            inst_count ++;
-            rwcount++;
-            if (o_flag) std::cout << " SEGV" << std::endl;
-            currentProcess->stats.segv ++;
+            inst_count += ins.count;
+            rwcount += ins.count;
+            currentProcess->stats.refs += ins.count;
+            if constexpr (Trace) std::cout << " SEGV" << std::endl;
+            currentProcess->stats.segv += ins.count;
             continue;
         } else if (command == 'r' || command == 'w') {
-            inst_count++;
-            rwcount++;
+            inst_count++;  // The rest of the run is counted once it is applied
+            rwcount += ins.count;
+            currentProcess->stats.refs += ins.count;
+            if (quota_adjust_interval && currentProcess->ws_stamp[vpage] != ws_epoch) {
+                currentProcess->ws_stamp[vpage] = ws_epoch;
+                currentProcess->ws_size++;
+            }
             pte_t& pte = currentProcess->page_table[vpage];
             if (!pte.present) {
-                handle_page_fault(frame_table, processes, *currentProcess, vpage);
+                handle_page_fault<PagerT, Trace, Timed>(pager, frame_table, processes, *currentProcess, vpage);
                 // cost += 350; // Cost for handling page fault
+            } else {
+                pager_of(pager, *currentProcess).on_reference(&frame_table[pte.frame_number]);
             }
+            // Later references of the run hit the page that is now resident. Past
+            // two hits the pager state repeats every other hit (see on_reference)
+            unsigned long hits = ins.count - 1;
+            if (hits > 3) hits = 2 + hits % 2;
+            for (unsigned long i = 0; i < hits; i++) {
+                pager_of(pager, *currentProcess).on_reference(&frame_table[pte.frame_number]);
+            }
+            inst_count += ins.count - 1;
             pte.referenced = 1;
-            if (command == 'w') {
+            if (ins.writes) {
                 if (!pte.write_protect) {
                     pte.modified = 1;
                     frame_table[pte.frame_number].dirty = true;  // Set the dirty flag on the frame
                 } else {
-                    if (o_flag) std::cout << " SEGPROT" << std::endl;
-                    currentProcess->stats.segprot ++;
+                    if constexpr (Trace) std::cout << " SEGPROT" << std::endl;
+                    currentProcess->stats.segprot += ins.writes;
                 }
             }
         }
         // printFrameTable(frame_table);
     }
+    current_pid = currentProcess ? currentProcess->pid : -1;
+    if (inst_count == pause_at) {
+        return true;
+    }
+    if (windows.size && inst_count > windows.next_end - windows.size) {
+        windows.record(processes, inst_count, rwcount, ctx_switches, process_exits);  // Last, partial window
+    }
+    return false;
+}
+
+
+// Pager object held by the variant, nullptr for std::monostate
+Pager* pager_ptr(PagerVariant& pager) {
+    return std::visit([](auto& p) -> Pager* {
+        if constexpr (std::is_same_v<std::decay_t<decltype(p)>, std::monostate>) {
+            return nullptr;
+        } else {
+            return &p;
+        }
+    }, pager);
+}
+
+std::vector<int> frame_indices(const std::vector<frame_t*>& frames, const std::vector<frame_t>& frame_table) {
+    std::vector<int> indices;
+    for (frame_t* frame : frames) indices.push_back(frame - frame_table.data());
+    return indices;
+}
+
+std::vector<frame_t*> frame_pointers(const std::vector<int>& indices, std::vector<frame_t>& frame_table) {
+    std::vector<frame_t*> frames;
+    for (int index : indices) frames.push_back(&frame_table[index]);
+    return frames;
+}
+
+void fill_all_frames(std::vector<frame_t>& frame_table) {
+    all_frames.clear();
+    for (auto& frame : frame_table) {
+        all_frames.push_back(&frame);
+    }
+}
+
+const char* const CHECKPOINT_MAGIC = "mmu-checkpoint-2";
+
+// Everything needed to continue the run at the current instruction. Frame
+// pointers (free list, per-process frame lists) are stored as frame numbers.
+// -w windows and the -oH histogram are not part of a checkpoint.
+void save_checkpoint(const std::string& filename, const std::string& algorithm, PagerVariant& pager,
+                     std::vector<frame_t>& frame_table, std::vector<Process>& processes, const InstructionReader& trace) {
+    Snapshot snap;
+    snap.put(std::string(CHECKPOINT_MAGIC));
+    snap.put(algorithm);
+    snap.put(numFrames);
+    snap.put(local_replacement);
+    trace.save(snap);
+    snap.put(inst_count);
+    snap.put(rwcount);
+    snap.put(ctx_switches);
+    snap.put(process_exits);
+    snap.put(exitloop);
+    snap.put(ofs);
+    snap.put(current_pid);
+    snap.put(TAU);
+    snap.put(quota_adjust_interval);
+    snap.put(next_quota_adjust);
+    snap.put(ws_epoch);
+
+    snap.put(frame_table);
+    snap.put(frame_indices(std::vector<frame_t*>(free_frames.begin(), free_frames.end()), frame_table));
+
+    snap.put(processes.size());
+    for (const auto& proc : processes) {
+        snap.put(proc.vmas.size());
+        for (const auto& vma : proc.vmas) snap.put(vma);
+        snap.put(proc.page_table);
+        snap.put(proc.stats);
+        snap.put(proc.quota);
+        snap.put(proc.max_quota);
+        snap.put(proc.reserve);
+        snap.put(frame_indices(proc.frames, frame_table));
+        snap.put(proc.exited);
+        snap.put(proc.ws_stamp);
+        snap.put(proc.ws_size);
+    }
+
+    pager_ptr(pager)->save(snap);
+    if (local_replacement) {
+        for (const auto& proc : processes) proc.pager->save(snap);
+    }
+    if (!snap.write(filename)) {
+        std::cerr << "Failed to write checkpoint: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Inverse of save_checkpoint; also rebuilds the pagers and moves the trace
+// to the next instruction
+void restore_checkpoint(const std::string& filename, std::string& algorithm, PagerVariant& pager,
+                        std::vector<frame_t>& frame_table, std::vector<Process>& processes, InstructionReader& trace) {
+    Snapshot snap;
+    if (!snap.read(filename)) {
+        std::cerr << "Failed to open checkpoint: " << filename << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    try {
+        std::string magic;
+        snap.get(magic);
+        if (magic != CHECKPOINT_MAGIC) throw std::runtime_error("not a checkpoint");
+        snap.get(algorithm);
+        snap.get(numFrames);
+        snap.get(local_replacement);
+        trace.load(snap);
+        snap.get(inst_count);
+        snap.get(rwcount);
+        snap.get(ctx_switches);
+        snap.get(process_exits);
+        snap.get(exitloop);
+        snap.get(ofs);
+        snap.get(current_pid);
+        snap.get(TAU);
+        snap.get(quota_adjust_interval);
+        snap.get(next_quota_adjust);
+        snap.get(ws_epoch);
+
+        snap.get(frame_table);
+        std::vector<int> free_list;
+        snap.get(free_list);
+        free_frames.clear();
+        for (int index : free_list) free_frames.push_back(&frame_table[index]);
+
+        size_t count;
+        snap.get(count);
+        processes.clear();
+        for (size_t pid = 0; pid < count; ++pid) {
+            processes.emplace_back(pid);
+            Process& proc = processes.back();
+            size_t vmas;
+            snap.get(vmas);
+            for (size_t i = 0; i < vmas; ++i) {
+                VMA vma(0, 0, false, false);
+                snap.get(vma);
+                proc.vmas.push_back(vma);
+            }
+            snap.get(proc.page_table);
+            snap.get(proc.stats);
+            snap.get(proc.quota);
+            snap.get(proc.max_quota);
+            snap.get(proc.reserve);
+            std::vector<int> frames;
+            snap.get(frames);
+            proc.frames = frame_pointers(frames, frame_table);
+            snap.get(proc.exited);
+            snap.get(proc.ws_stamp);
+            snap.get(proc.ws_size);
+        }
+
+        if (!emplace_pager(pager, algorithm, frame_table, processes, numFrames)) {
+            throw std::runtime_error("unknown algorithm " + algorithm);
+        }
+        pager_ptr(pager)->load(snap);
+        if (local_replacement) {
+            for (auto& proc : processes) {
+                proc.pager = create_pager(algorithm, frame_table, processes, proc.max_quota);
+                proc.pager->load(snap);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid checkpoint " << filename << ": " << e.what() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    fill_all_frames(frame_table);
+}
+
+// What-if settings applied when a run is forked (-b) or restored (-r with -f/-a)
+struct Settings {
+    int frames = 0;          // 0 = unchanged
+    std::string algorithm;   // Empty = unchanged
+    long tau = -1;           // Working set window, -1 = unchanged
+};
+
+// "f=<frames>,a=<algo>,tau=<instructions>", every part optional
+bool parse_settings(const std::string& spec, Settings& settings) {
+    std::istringstream iss(spec);
+    std::string item;
+    while (getline(iss, item, ',')) {
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) return false;
+        std::string key = item.substr(0, eq), value = item.substr(eq + 1);
+        try {
+            if (key == "f") settings.frames = std::stoi(value);
+            else if (key == "a") settings.algorithm = value;
+            else if (key == "tau") settings.tau = std::stol(value);
+            else return false;
+        } catch (const std::exception& e) {
+            return false;
+        }
+        if (key == "f" && (settings.frames <= 0 || settings.frames > MAX_FRAMES)) return false;
+        if (key == "tau" && settings.tau < 0) return false;
+    }
+    return true;
+}
+
+// Change the number of frames in the middle of a run. Pages in frames that go
+// away are evicted (UNMAP and OUT/FOUT are charged as usual), new frames join
+// the free list. Default quotas (the whole frame table) follow the new size.
+void resize_frames(int frames, std::vector<frame_t>& frame_table, std::vector<Process>& processes) {
+    for (size_t i = frames; i < frame_table.size(); ++i) {
+        frame_t* frame = &frame_table[i];
+        if (frame->process_id != -1 && frame->virtual_page != -1) {
+            Process& owner = processes[frame->process_id];
+            unmap<false>(frame, owner);
+            out<false>(frame, owner);
+        }
+    }
+    std::vector<int> free_list;
+    for (frame_t* frame : free_frames) {
+        if (frame - frame_table.data() < frames) free_list.push_back(frame - frame_table.data());
+    }
+    std::vector<std::vector<int>> owned;
+    for (auto& proc : processes) {
+        owned.push_back(frame_indices(proc.frames, frame_table));
+        owned.back().erase(std::remove_if(owned.back().begin(), owned.back().end(),
+                                          [&](int index) { return index >= frames; }), owned.back().end());
+    }
+
+    for (int i = frame_table.size(); i < frames; ++i) free_list.push_back(i);
+    frame_table.resize(frames);
+    free_frames.clear();
+    for (int index : free_list) free_frames.push_back(&frame_table[index]);
+    for (size_t pid = 0; pid < processes.size(); ++pid) {
+        Process& proc = processes[pid];
+        proc.frames = frame_pointers(owned[pid], frame_table);
+        if (proc.max_quota == (unsigned int)numFrames) proc.max_quota = frames;
+        if (proc.quota == (unsigned int)numFrames) proc.quota = frames;
+        proc.max_quota = std::min<unsigned int>(proc.max_quota, frames);
+        proc.quota = std::min<unsigned int>(proc.quota, frames);
+    }
+    numFrames = frames;
+    fill_all_frames(frame_table);
+}
+
+// Fresh pagers of the current algorithm and frame count, told about the
+// resident pages in frame order as if they had just been mapped
+void rebuild_pagers(PagerVariant& pager, const std::string& algorithm, std::vector<frame_t>& frame_table, std::vector<Process>& processes) {
+    if (!emplace_pager(pager, algorithm, frame_table, processes, numFrames)) {
+        std::cerr << "Allowed page replacement algorithm calls are : a/c/e/f/r/w/arc/car/2q/lirs\n";
+        exit(EXIT_FAILURE);
+    }
+    if (local_replacement) {
+        for (auto& proc : processes) {
+            delete proc.pager;
+            proc.pager = create_pager(algorithm, frame_table, processes, proc.max_quota);
+        }
+    }
+    for (auto& frame : frame_table) {
+        if (frame.process_id != -1 && frame.virtual_page != -1) {
+            Pager* owner = local_replacement ? processes[frame.process_id].pager : pager_ptr(pager);
+            owner->on_map(&frame);
+        }
+    }
+}
+
+void apply_settings(const Settings& settings, PagerVariant& pager, std::string& algorithm,
+                    std::vector<frame_t>& frame_table, std::vector<Process>& processes) {
+    if (settings.tau >= 0) {
+        TAU = settings.tau;
+    }
+    bool rebuild = false;
+    if (settings.frames && settings.frames != numFrames) {
+        resize_frames(settings.frames, frame_table, processes);
+        rebuild = true;
+    }
+    if (!settings.algorithm.empty() && settings.algorithm != algorithm) {
+        algorithm = settings.algorithm;
+        rebuild = true;
+    }
+    if (rebuild) {
+        rebuild_pagers(pager, algorithm, frame_table, processes);
+    }
+}
+
+// Run every branch in a child process of its own, one after the other: fork()
+// gives each a copy-on-write copy of the whole simulator. Returns the branch
+// number (from 1) in a child and 0 in the parent once all children are done.
+int fork_branches(size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        fflush(stdout);
+        pid_t child = fork();
+        if (child == -1) {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (child == 0) {
+            return i + 1;
+        }
+        int status;
+        waitpid(child, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cerr << "Branch " << i + 1 << " failed" << std::endl;
+        }
+    }
+    return 0;
+}
+
+// Differential check (-d): the trace is simulated twice in lockstep. The
+// reference run goes through the virtual Pager interface one reference at a
+// time, with the reference pagers (see create_reference_pager); the optimized
+// run is the specialized loop with merged reference runs and the production
+// pagers. After every victim selection of the reference run the optimized run
+// is brought to the same instruction and the two are compared.
+//
+// The simulator state lives in globals, so each run keeps its copy of them
+// here while the other run is being stepped.
+struct DiffRun {
+    std::vector<frame_t> frame_table;
+    std::vector<Process> processes;
+    PagerVariant pager;           // Optimized run
+    Pager* reference = nullptr;   // Reference run
+    InputStream file;
+    InstructionReader trace{file};
+
+    unsigned long inst_count = 0, rwcount = 0, ctx_switches = 0, process_exits = 0;
+    bool exitloop = false;
+    int ofs = 0;
+    int current_pid = -1;
+    unsigned long next_quota_adjust = 0;
+    unsigned int ws_epoch = 1;
+    std::deque<frame_t*> free_frames;
+    std::vector<frame_t*> all_frames;
+    VictimLog victims;
+
+    // Called in pairs around everything that runs on this state
+    void swap_globals() {
+        std::swap(::inst_count, inst_count);
+        std::swap(::rwcount, rwcount);
+        std::swap(::ctx_switches, ctx_switches);
+        std::swap(::process_exits, process_exits);
+        std::swap(::exitloop, exitloop);
+        std::swap(::ofs, ofs);
+        std::swap(::current_pid, current_pid);
+        std::swap(::next_quota_adjust, next_quota_adjust);
+        std::swap(::ws_epoch, ws_epoch);
+        std::swap(::free_frames, free_frames);
+        std::swap(::all_frames, all_frames);
+        std::swap(::victims, victims);
+    }
+};
+
+void setup_diff_run(DiffRun& run, bool reference, const std::string& algorithm, const std::string& quotaFile, const std::string& inputFile) {
+    run.swap_globals();
+    if (!run.file.open(inputFile)) {
+        std::cerr << "Failed to open file: " << inputFile << " (" << run.file.last_error() << ")" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (!run.file.reopenable()) {
+        std::cerr << "-d reads " << inputFile << " twice, which only works for files" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    run.frame_table.resize(numFrames);
+    for (auto& frame : run.frame_table) {
+        free_frames.push_back(&frame);
+    }
+    load_processes(run.processes, run.frame_table, run.file);
+    if (!quotaFile.empty()) {
+        load_quotas(quotaFile, run.processes);
+    }
+    if (reference) {
+        run.reference = create_reference_pager(algorithm, run.frame_table, run.processes, numFrames);
+    } else {
+        emplace_pager(run.pager, algorithm, run.frame_table, run.processes, numFrames);
+    }
+    if (!run.reference && std::holds_alternative<std::monostate>(run.pager)) {
+        std::cout<< "Allowed page replacement algorithm calls are : a/c/e/f/r/w/arc/car/2q/lirs";
+        exit(EXIT_FAILURE);
+    }
+    fill_all_frames(run.frame_table);
+    if (local_replacement) {
+        for (auto& proc : run.processes) {
+            proc.pager = reference ? create_reference_pager(algorithm, run.frame_table, run.processes, proc.max_quota)
+                                   : create_pager(algorithm, run.frame_table, run.processes, proc.max_quota);
+        }
+    }
+    run.swap_globals();
+}
+
+std::string pte_bits(const pte_t& pte) {
+    std::string bits;
+    bits += pte.present ? 'P' : '-';
+    bits += pte.referenced ? 'R' : '-';
+    bits += pte.modified ? 'M' : '-';
+    bits += pte.write_protect ? 'W' : '-';
+    bits += pte.paged_out ? 'S' : '-';
+    bits += pte.file_mapped ? 'F' : '-';
+    if (pte.present) bits += "@" + std::to_string(pte.frame_number);
+    return bits;
+}
+
+std::string stats_line(const ProcessStats& stats) {
+    char line[256];
+    snprintf(line, sizeof(line), "U=%lu M=%lu I=%lu O=%lu FI=%lu FO=%lu Z=%lu SV=%lu SP=%lu refs=%lu",
+             stats.unmaps, stats.maps, stats.ins, stats.outs, stats.fins, stats.fouts, stats.zeros,
+             stats.segv, stats.segprot, stats.refs);
+    return line;
+}
+
+// Differences between the two runs (both swapped out), at most 'limit' of them
+std::vector<std::string> diff_runs(const DiffRun& ref, const DiffRun& opt, size_t limit) {
+    std::vector<std::string> diffs;
+    auto report = [&](const std::string& what, const std::string& a, const std::string& b) {
+        if (diffs.size() < limit) diffs.push_back(what + ": reference " + a + ", optimized " + b);
+    };
+    auto frame_index = [](const DiffRun& run) {
+        return run.victims.frame ? std::to_string(run.victims.frame - run.frame_table.data()) : std::string("none");
+    };
+    auto counter = [&](const char* what, unsigned long a, unsigned long b) {
+        if (a != b) report(what, std::to_string(a), std::to_string(b));
+    };
+    counter("victim selections", ref.victims.count, opt.victims.count);
+    if (ref.victims.count == opt.victims.count) {
+        counter("victim selected at instruction", ref.victims.first, opt.victims.first);
+        if (frame_index(ref) != frame_index(opt)) report("victim frame", frame_index(ref), frame_index(opt));
+    }
+    counter("instructions", ref.inst_count, opt.inst_count);
+    counter("references", ref.rwcount, opt.rwcount);
+    counter("context switches", ref.ctx_switches, opt.ctx_switches);
+    counter("process exits", ref.process_exits, opt.process_exits);
+    for (size_t i = 0; i < ref.frame_table.size() && i < opt.frame_table.size(); ++i) {
+        const frame_t& a = ref.frame_table[i];
+        const frame_t& b = opt.frame_table[i];
+        if (a.process_id != b.process_id || a.virtual_page != b.virtual_page || a.dirty != b.dirty) {
+            auto owner = [](const frame_t& f) {
+                return std::to_string(f.process_id) + ":" + std::to_string(f.virtual_page) + (f.dirty ? " dirty" : "");
+            };
+            report("FT[" + std::to_string(i) + "]", owner(a), owner(b));
+        }
+    }
+    for (size_t pid = 0; pid < ref.processes.size() && pid < opt.processes.size(); ++pid) {
+        const Process& a = ref.processes[pid];
+        const Process& b = opt.processes[pid];
+        for (int vpage = 0; vpage < NUM_VIRTUAL_PAGES; ++vpage) {
+            if (memcmp(&a.page_table[vpage], &b.page_table[vpage], sizeof(pte_t)) != 0) {
+                report("PT[" + std::to_string(pid) + "][" + std::to_string(vpage) + "]",
+                       pte_bits(a.page_table[vpage]), pte_bits(b.page_table[vpage]));
+            }
+        }
+        if (memcmp(&a.stats, &b.stats, sizeof(ProcessStats)) != 0) {
+            report("PROC[" + std::to_string(pid) + "]", stats_line(a.stats), stats_line(b.stats));
+        }
+    }
+    return diffs;
+}
+
+// Runs the trace through both implementations; returns the exit status
+int run_differential(const std::string& algorithm, const std::string& quotaFile, const std::string& inputFile) {
+    DiffRun ref, opt;
+    setup_diff_run(ref, true, algorithm, quotaFile, inputFile);
+    setup_diff_run(opt, false, algorithm, quotaFile, inputFile);
+
+    bool more = true;
+    while (more) {
+        // Reference run: one instruction at a time up to its next victim selection
+        ref.swap_globals();
+        victims.first = ULONG_MAX;
+        unsigned long selections = victims.count;
+        do {
+            pause_at = inst_count + 1;
+            more = simulate<Pager, false, false>(*ref.reference, ref.processes, ref.frame_table, ref.trace);
+        } while (more && victims.count == selections);
+        unsigned long until = more ? inst_count : ULONG_MAX;
+        ref.swap_globals();
+
+        // Optimized run: up to the same instruction, or the end of the trace
+        opt.swap_globals();
+        victims.first = ULONG_MAX;
+        pause_at = until;
+        std::visit([&](auto& selected) {
+            using PagerT = std::decay_t<decltype(selected)>;
+            if constexpr (!std::is_same_v<PagerT, std::monostate>) {
+                simulate<PagerT, false, false>(selected, opt.processes, opt.frame_table, opt.trace);
+            }
+        }, opt.pager);
+        opt.swap_globals();
+
+        std::vector<std::string> diffs = diff_runs(ref, opt, 10);
+        if (!diffs.empty()) {
+            unsigned long at = std::min(ref.victims.first, opt.victims.first);
+            if (at == ULONG_MAX) {
+                printf("DIFF: runs diverge by the end of the trace (instruction %lu)\n", ref.inst_count);
+            } else {
+                printf("DIFF: runs diverge at instruction %lu (victim selection %lu of the reference run)\n",
+                       at, ref.victims.count);
+            }
+            for (const auto& diff : diffs) {
+                printf("DIFF:   %s\n", diff.c_str());
+            }
+            return 1;
+        }
+    }
+    printf("DIFF: ok, %lu instructions, %lu victim selections compared\n", ref.inst_count, ref.victims.count);
+    return 0;
 }
 
 
@@ -783,6 +2895,16 @@ void printProcessStats(const std::vector<Process>& processes) {
     }
 }
 
+void printProcessRates(const std::vector<Process>& processes, const std::vector<frame_t>& frame_table) {
+    for (const auto& proc : processes) {
+        size_t frames = std::count_if(frame_table.begin(), frame_table.end(),
+                                      [&](const frame_t& f) { return f.process_id == proc.pid; });
+        double rate = proc.stats.refs ? (double)proc.stats.maps / proc.stats.refs : 0.0;
+        printf("PROCRATE[%d]: refs=%lu faults=%lu rate=%.4f frames=%zu quota=%u reserve=%u\n",
+               proc.pid, proc.stats.refs, proc.stats.maps, rate, frames, proc.quota, proc.reserve);
+    }
+}
+
 void printSimulationSummary(const std::vector<Process>& processes,
                             unsigned long inst_count,
                             unsigned long ctx_switches,
@@ -796,6 +2918,50 @@ void printSimulationSummary(const std::vector<Process>& processes,
            inst_count, ctx_switches, process_exits, total_cost, sizeof(pte_t));
 }
 
+// -oT: where the cycles went. Victim selection happens inside fault handling
+// and is reported separately; "other" is the rest of the simulation loop
+// (VMA checks, hits, context switches, exits).
+void printPhaseBreakdown(unsigned long long final_output_cycles) {
+    unsigned long long cycles[NUM_PHASES + 1];
+    std::copy(phase_cycles, phase_cycles + NUM_PHASES, cycles);
+    unsigned long long in_loop = phase_cycles[PHASE_PARSE] + phase_cycles[PHASE_FAULT] + phase_cycles[PHASE_OUTPUT];
+    cycles[PHASE_FAULT] -= phase_cycles[PHASE_VICTIM];
+    cycles[PHASE_OUTPUT] += final_output_cycles;
+    cycles[NUM_PHASES] = sim_cycles > in_loop ? sim_cycles - in_loop : 0;
+    unsigned long long total = sim_cycles + final_output_cycles;
+
+    for (int i = 0; i <= NUM_PHASES; ++i) {
+        printf("PHASE[%s]: cycles=%llu calls=%lu pct=%.1f\n", i < NUM_PHASES ? PHASE_NAMES[i] : "other",
+               cycles[i], i < NUM_PHASES ? phase_calls[i] : 0UL, total ? 100.0 * cycles[i] / total : 0.0);
+    }
+    if (!hw_counters.available) {
+        printf("HWCOUNTERS: unavailable (%s)\n", hw_counters.error.c_str());
+        return;
+    }
+    const char* names[HwCounters::NUM_COUNTERS] = { "cycles", "instructions", "cache-misses", "branch-misses" };
+    printf("HWCOUNTERS:");
+    for (int i = 0; i < HwCounters::NUM_COUNTERS; ++i) {
+        if (hw_counters.opened[i]) printf(" %s=%llu", names[i], hw_counters.values[i]);
+        else printf(" %s=n/a", names[i]);
+    }
+    if (hw_counters.opened[HwCounters::CYCLES] && hw_counters.opened[HwCounters::INSTRUCTIONS] && hw_counters.values[HwCounters::CYCLES]) {
+        printf(" ipc=%.2f", (double)hw_counters.values[HwCounters::INSTRUCTIONS] / hw_counters.values[HwCounters::CYCLES]);
+    }
+    printf("\n");
+}
+
+// Machine readable line for bench.sh: instructions, read/write references,
+// page faults, seconds spent in simulate() and peak resident set size
+void printBenchSummary(const std::vector<Process>& processes, double seconds) {
+    unsigned long faults = 0;
+    for (const auto& proc : processes) {
+        faults += proc.stats.maps;
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("BENCH %lu %lu %lu %.6f %ld\n", inst_count, rwcount, faults, seconds, usage.ru_maxrss);
+}
+
 // Function to check if 'str' contains the substring 'substring'
 bool containsSubstring(const std::string& str, const std::string& substring) {
     return str.find(substring) != std::string::npos;
@@ -807,15 +2973,21 @@ int main(int argc, char* argv[]) {
     std::string algorithm;
     std::string options;
 
-    FIFOPager pager; // Use the appropriate pager based on your needs
-
     int opt;
-    while ((opt = getopt(argc, argv, "f:a:o:")) != -1) {
+    std::string quotaFile;
+    long windowSize = 0;
+    int framesArg = 0;
+    unsigned long checkpointAt = ULONG_MAX, branchAt = ULONG_MAX;
+    std::string checkpointFile, restoreFile;
+    std::vector<std::string> branchSpecs;
+    std::vector<Settings> branches;
+    bool diffCheck = false;
+    while ((opt = getopt(argc, argv, "f:a:o:q:Lw:c:r:b:d")) != -1) {
         switch (opt) {
             case 'f':
-                numFrames = std::stoi(optarg);
-                if (numFrames <= 0 || numFrames > 128) {
-                    std::cerr << "Number of frames must be between 1 and 128.\n";
+                numFrames = framesArg = std::stoi(optarg);
+                if (numFrames <= 0 || numFrames > MAX_FRAMES) {
+                    std::cerr << "Number of frames must be between 1 and " << MAX_FRAMES << ".\n";
                     exit(EXIT_FAILURE);
                 }
                 break;
@@ -825,12 +2997,75 @@ int main(int argc, char* argv[]) {
             case 'o':
                 options = optarg;
                 break;
+            case 'q':
+                quotaFile = optarg;
+                break;
+            case 'L':
+                local_replacement = true;
+                break;
+            case 'w':
+                windowSize = std::stol(optarg);
+                if (windowSize <= 0) {
+                    std::cerr << "Window size must be a positive number of instructions.\n";
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'c':
+            case 'b': {
+                // <instruction>:<checkpoint file> or <instruction>:<settings>
+                std::string arg = optarg;
+                size_t colon = arg.find(':');
+                unsigned long at = 0;
+                try {
+                    at = std::stoul(arg.substr(0, colon));
+                } catch (const std::exception& e) {
+                    colon = std::string::npos;
+                }
+                if (colon == std::string::npos) {
+                    std::cerr << "Expected -" << (char)opt << "<instruction>:" << (opt == 'c' ? "<file>" : "<settings>") << "\n";
+                    exit(EXIT_FAILURE);
+                }
+                if (opt == 'c') {
+                    checkpointAt = at;
+                    checkpointFile = arg.substr(colon + 1);
+                    break;
+                }
+                Settings settings;
+                if (!parse_settings(arg.substr(colon + 1), settings)) {
+                    std::cerr << "Invalid branch settings <" << arg.substr(colon + 1) << ">, expected f=<frames>,a=<algo>,tau=<n>\n";
+                    exit(EXIT_FAILURE);
+                }
+                if (branchAt != ULONG_MAX && at != branchAt) {
+                    std::cerr << "All branches must fork at the same instruction.\n";
+                    exit(EXIT_FAILURE);
+                }
+                branchAt = at;
+                branchSpecs.push_back(arg.substr(colon + 1));
+                branches.push_back(settings);
+                break;
+            }
+            case 'r':
+                restoreFile = optarg;
+                break;
+            case 'd':
+                diffCheck = true;
+                break;
             default: // '?'
-                std::cerr << "Usage: " << argv[0] << " -f<num_frames> -a<algo> [-o<options>] inputfile randomfile\n";
+                std::cerr << "Usage: " << argv[0] << " -f<num_frames> -a<algo> [-o<options>] [-q<quotafile>] [-L] [-w<window>] [-c<inst>:<file>] [-r<file>] [-b<inst>:<settings>] [-d] inputfile randomfile\n";
                 exit(EXIT_FAILURE);
         }
     }
 
+    if (!restoreFile.empty() && (!quotaFile.empty() || local_replacement)) {
+        std::cerr << "Quotas and replacement scope come from the checkpoint, -q and -L cannot be combined with -r\n";
+        exit(EXIT_FAILURE);
+    }
+
+    if (diffCheck && (windowSize || checkpointAt != ULONG_MAX || !restoreFile.empty() || branchAt != ULONG_MAX)) {
+        std::cerr << "-d cannot be combined with -w, -c, -r or -b\n";
+        exit(EXIT_FAILURE);
+    }
+
     if (argc - optind != 2) {
         std::cerr << "Expected inputfile and randomfile after options\n";
         exit(EXIT_FAILURE);
@@ -845,49 +3080,138 @@ int main(int argc, char* argv[]) {
     // Read random numbers
     // string randomFile = argv[optind + 1]; // Assuming random file is the second non-option argument
     readRandomNumbers(randomFile);
+    if (diffCheck) {
+        return run_differential(algorithm, quotaFile, inputFile);
+    }
 
-    std::vector<frame_t> frame_table(numFrames);
+    std::vector<frame_t> frame_table;
     // std::cout << "Frame table initialized with size: " << frame_table.size() << std::endl;
 
     std::string filename = inputFile;
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open file: " << filename << std::endl;
+    InputStream file;
+    if (!file.open(filename)) {
+        std::cerr << "Failed to open file: " << filename << " (" << file.last_error() << ")" << std::endl;
         return 1;
     }
-    // Initialize the free frames deque with all frames as available
-    for (int i = 0; i < numFrames; ++i) {
-        free_frames.push_back(&frame_table[i]);
-    }
+    InstructionReader trace(file);
+
+    PagerVariant pager;
+    if (!restoreFile.empty()) {
+        // Continue a checkpointed run; -f and -a change its settings from here on
+        Settings overrides;
+        overrides.frames = framesArg;
+        overrides.algorithm = algorithm;
+        restore_checkpoint(restoreFile, algorithm, pager, frame_table, processes, trace);
+        if (std::min(checkpointAt, branchAt) < inst_count) {
+            std::cerr << "The checkpoint is at instruction " << inst_count << ", after the -c/-b point" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        apply_settings(overrides, pager, algorithm, frame_table, processes);
+    } else {
+        frame_table.resize(numFrames);
+        // Initialize the free frames deque with all frames as available
+        for (int i = 0; i < numFrames; ++i) {
+            free_frames.push_back(&frame_table[i]);
+        }
 
+        // Now proceed with the rest of your main function logic
+        load_processes(processes, frame_table, file);
 
-    // Now proceed with the rest of your main function logic
-    load_processes(processes, frame_table, file);
+        if (!quotaFile.empty()) {
+            load_quotas(quotaFile, processes);
+        }
 
-    // Instantiate the Pager Replacement Algorithm
-    if(algorithm == "a"){
-        THE_PAGER = new AgingPager(frame_table);
-    }else if (algorithm == "c"){
-        THE_PAGER = new ClockPager(frame_table);
-    } else if (algorithm == "e"){
-        THE_PAGER = new NRUPager(frame_table, processes);     
-    } else if (algorithm == "f"){
-        THE_PAGER = new FIFOPager();
-    } else if (algorithm == "r"){
-        THE_PAGER = new RandomPager();
-    } else if (algorithm == "w"){
-        THE_PAGER = new WorkingSetPager(frame_table, processes);
-    } else{
-        std::cout<< "Allowed page replacement algorithm calls are : a/c/e/f/r/w";
+        // Instantiate the Pager Replacement Algorithm
+        if (!emplace_pager(pager, algorithm, frame_table, processes, numFrames)) {
+            std::cout<< "Allowed page replacement algorithm calls are : a/c/e/f/r/w/arc/car/2q/lirs";
+            exit(EXIT_FAILURE);
+        }
+        fill_all_frames(frame_table);
+        if (local_replacement) {
+            for (auto& proc : processes) {
+                proc.pager = create_pager(algorithm, frame_table, processes, proc.max_quota);
+            }
+        }
     }
 
     if (containsSubstring(options, "O")){
         o_flag = true;
     }
     
-    simulate(processes, frame_table, file);
+    if (windowSize) {
+        windows.init(windowSize, processes, inst_count, rwcount, ctx_switches, process_exits);
+    }
+    record_fault_cost = containsSubstring(options, "H");
+
+    bool t_flag = containsSubstring(options, "T");
+    if (t_flag) {
+        hw_counters.start();
+    }
+    unsigned long long sim_cycles_start = read_cycles();
+    auto sim_start = std::chrono::steady_clock::now();
+    auto run = [&]() {
+        return std::visit([&](auto& selected) {
+            using PagerT = std::decay_t<decltype(selected)>;
+            if constexpr (std::is_same_v<PagerT, std::monostate>) {
+                return false;
+            } else {
+                if (o_flag && t_flag) {
+                    return simulate<PagerT, true, true>(selected, processes, frame_table, trace);
+                } else if (o_flag) {
+                    return simulate<PagerT, true, false>(selected, processes, frame_table, trace);
+                } else if (t_flag) {
+                    return simulate<PagerT, false, true>(selected, processes, frame_table, trace);
+                } else {
+                    return simulate<PagerT, false, false>(selected, processes, frame_table, trace);
+                }
+            }
+        }, pager);
+    };
+    // The loop only pauses to write a checkpoint (-c) or fork branches (-b)
+    pause_at = std::min(checkpointAt, branchAt);
+    while (run()) {
+        long long offset = file.tell();
+        if (inst_count == checkpointAt) {
+            save_checkpoint(checkpointFile, algorithm, pager, frame_table, processes, trace);
+            checkpointAt = ULONG_MAX;
+        }
+        if (inst_count == branchAt) {
+            if (!file.reopenable()) {
+                std::cerr << "Branches need to open " << filename << " again, which only works for files" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            branchAt = ULONG_MAX;
+            file.suspend();
+            int branch = fork_branches(branches.size());
+            if (branch) {
+                // Own file descriptor: the parent's read offset must not move
+                file.close();
+                if (!file.open(filename) || !file.skip_to(offset)) {
+                    std::cerr << "Branch " << branch << " failed to reopen " << filename << " at the branch position" << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                checkpointAt = ULONG_MAX;  // A later -c is written by the base run only
+                printf("BRANCH[%d]: at=%lu %s\n", branch, inst_count, branchSpecs[branch - 1].c_str());
+                apply_settings(branches[branch - 1], pager, algorithm, frame_table, processes);
+            } else {
+                file.resume();
+                printf("BRANCH[0]: at=%lu base\n", inst_count);
+            }
+        }
+        pause_at = std::min(checkpointAt, branchAt);
+    }
+    if (checkpointAt != ULONG_MAX || branchAt != ULONG_MAX) {
+        std::cerr << "Trace ended after " << inst_count << " instructions, before the checkpoint/branch point" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::chrono::duration<double> sim_seconds = std::chrono::steady_clock::now() - sim_start;
+    sim_cycles = read_cycles() - sim_cycles_start;
+    if (t_flag) {
+        hw_counters.stop();
+    }
     
     file.close();
+    windows.drain();
 
 
     // Compute total cost here if not done elsewhere
@@ -904,16 +3228,29 @@ int main(int argc, char* argv[]) {
     // Cost for process exits
     total_cost += process_exits * 1230;
 
+    unsigned long long output_start = read_cycles();
     if (containsSubstring(options, "P")){
         printPageTables(processes);
     }
     if (containsSubstring(options, "F")){
         printFrameTable(frame_table);
     }
+    if (containsSubstring(options, "R")){
+        printProcessRates(processes, frame_table);
+    }
     if (containsSubstring(options, "S")){
         printProcessStats(processes);
         printSimulationSummary(processes, inst_count, ctx_switches, process_exits, total_cost);
     }
+    if (containsSubstring(options, "B")){
+        printBenchSummary(processes, sim_seconds.count());
+    }
+    if (record_fault_cost) {
+        fault_costs.print("FAULTCOST");
+    }
+    if (t_flag) {
+        printPhaseBreakdown(read_cycles() - output_start);
+    }
 
     return 0;
 }
@@ -0,0 +1,61 @@
+#!/bin/bash
+
+# Compares page replacement algorithms on scan-heavy synthetic traces:
+# process 0 loops over a small hot set while the other processes
+# periodically stream sequentially through their whole address space.
+#
+#example ./scanbench.sh            (or FRAMES="16 32" HOT=12 ./scanbench.sh)
+
+MMU=${MMU:-./mmu}
+RFILE=${RFILE:-rfile}
+
+ALGOS=${ALGOS:-"f c a arc car 2q lirs"}
+FRAMES=${FRAMES:-"16 32 64"}
+PROCS=${PROCS:-4}          # process 0 is hot, the rest are scanners
+HOT=${HOT:-"8 24"}         # hot set sizes (pages of process 0)
+HOTREFS=${HOTREFS:-200}    # hot references between two scans
+ROUNDS=${ROUNDS:-50}
+SEED=${SEED:-4800}
+
+[[ ! -x ${MMU} ]] && echo "simulator <${MMU}> not found, run make first" && exit 1
+
+TMP=$(mktemp -d)
+trap "rm -rf ${TMP}" EXIT
+
+gen_trace() {
+    awk -v procs=${PROCS} -v hot=$1 -v hotrefs=${HOTREFS} -v rounds=${ROUNDS} -v seed=${SEED} 'BEGIN {
+        srand(seed)
+        printf "#scan-heavy trace\n#\tprocs=%d hot=%d hotrefs=%d rounds=%d seed=%d\n", procs, hot, hotrefs, rounds, seed
+        print procs
+        for (p = 0; p < procs; p++) {
+            printf "#### process %d\n#\n1\n0 63 0 0\n", p
+        }
+        print "#### instruction simulation ######"
+        for (r = 0; r < rounds; r++) {
+            print "c 0"
+            for (i = 0; i < hotrefs; i++) {
+                printf "%s %d\n", (rand() < 0.9 ? "r" : "w"), int(rand() * hot)
+            }
+            printf "c %d\n", 1 + r % (procs - 1)
+            for (v = 0; v < 64; v++) {
+                printf "r %d\n", v
+            }
+        }
+    }'
+}
+
+printf "%-5s %-7s" "hot" "frames"
+for A in ${ALGOS}; do printf " %10s" "${A}"; done
+echo "   (page faults)"
+
+for H in ${HOT}; do
+    gen_trace ${H} > ${TMP}/trace
+    for N in ${FRAMES}; do
+        OUTLINE=`printf "%-5s %-7s" "${H}" "${N}"`
+        for A in ${ALGOS}; do
+            FAULTS=`${MMU} -f${N} -a${A} -oS ${TMP}/trace ${RFILE} | awk -F'[ =]' '/^PROC/ { m += $5 } END { print m }'`
+            OUTLINE=`printf "%s %10s" "${OUTLINE}" "${FAULTS}"`
+        done
+        echo "${OUTLINE}"
+    done
+done
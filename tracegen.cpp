@@ -0,0 +1,211 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <climits>
+
+// Deterministic synthetic trace generator for mmu. Parameters use the names
+// of the generator header found at the top of every file in inputs/, e.g.
+//
+//   ./tracegen procs=4 vmas=6 inst=5000 read=75 lambda=1.9 holes=2 wprot=2 mmap=1 seed=1036800
+//
+// The trace goes to stdout, so it can be streamed straight into the simulator:
+//
+//   ./mmu -f32 -ac -oS <(./tracegen procs=4 inst=1000000) rfile
+
+
+struct GenParams {
+    int procs = 4;          // Number of processes
+    int vmas = 6;           // Max VMAs per process (process 0 always gets this many)
+    unsigned long inst = 5000;  // Read/write instructions (context switches and exits come on top)
+    int pages = 64;         // Virtual pages per process (mmu supports at most 64)
+    double read = 75.0;     // Percentage of reads
+    double lambda = 1.9;    // Locality: distance between successive references of a
+                            // process is exponential with mean pages / (4 * lambda)
+    int holes = 2;          // Unmapped single-page gaps per multi-VMA process
+    int wprot = 2;          // Write protected VMAs per multi-VMA process
+    int mmap = 1;           // File mapped VMAs per multi-VMA process
+    unsigned long seed = 4800;
+    int burst = 20;         // Mean number of instructions between context switches
+    int exits = 0;          // Processes exiting before the end of the trace
+};
+
+// splitmix64: fully specified, so traces are identical on every platform
+class Random {
+private:
+    uint64_t state;
+
+public:
+    explicit Random(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, n)
+    int below(int n) {
+        return static_cast<int>(next() % static_cast<uint64_t>(n));
+    }
+
+    // Uniform in [0, 1)
+    double uniform() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
+struct GenVMA {
+    int start_vpage;
+    int end_vpage;
+    bool write_protected;
+    bool file_mapped;
+};
+
+// Mark 'count' distinct random VMAs with the given flag
+void mark_random(std::vector<GenVMA>& vmas, int count, bool GenVMA::*flag, Random& rng) {
+    std::vector<int> order(vmas.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    for (int i = 0; i < count && i < (int)order.size(); ++i) {
+        std::swap(order[i], order[i + rng.below(order.size() - i)]);
+        vmas[order[i]].*flag = true;
+    }
+}
+
+std::vector<GenVMA> make_vmas(const GenParams& params, int pid, Random& rng) {
+    int count = pid == 0 ? params.vmas : 1 + rng.below(params.vmas);
+    if (count <= 1) {
+        return {{0, params.pages - 1, false, false}};
+    }
+    int holes = std::min(params.holes, count + 1);
+    count = std::min(count, params.pages - holes);
+
+    // Split the mapped pages into 'count' non-empty VMAs
+    std::vector<int> sizes(count, 1);
+    for (int i = count; i < params.pages - holes; ++i) {
+        sizes[rng.below(count)]++;
+    }
+    // Holes go into distinct gaps: before, between or after the VMAs
+    std::vector<bool> hole_before(count + 1, false);
+    for (int placed = 0; placed < holes;) {
+        int gap = rng.below(count + 1);
+        if (!hole_before[gap]) {
+            hole_before[gap] = true;
+            placed++;
+        }
+    }
+
+    std::vector<GenVMA> vmas;
+    int vpage = 0;
+    for (int i = 0; i < count; ++i) {
+        if (hole_before[i]) vpage++;
+        vmas.push_back({vpage, vpage + sizes[i] - 1, false, false});
+        vpage += sizes[i];
+    }
+    mark_random(vmas, params.wprot, &GenVMA::write_protected, rng);
+    mark_random(vmas, params.mmap, &GenVMA::file_mapped, rng);
+    return vmas;
+}
+
+void generate(const GenParams& params) {
+    Random rng(params.seed);
+
+    printf("#process/vma/page reference generator\n");
+    printf("#\tprocs=%d #vmas=%d #inst=%lu pages=%d %%read=%f lambda=%f\n",
+           params.procs, params.vmas, params.inst, params.pages, params.read, params.lambda);
+    printf("#\tholes=%d wprot=%d mmap=%d seed=%lu\n", params.holes, params.wprot, params.mmap, params.seed);
+    printf("%d\n", params.procs);
+    for (int pid = 0; pid < params.procs; ++pid) {
+        std::vector<GenVMA> vmas = make_vmas(params, pid, rng);
+        printf("#### process %d\n#\n%zu\n", pid, vmas.size());
+        for (const auto& vma : vmas) {
+            printf("%d %d %d %d\n", vma.start_vpage, vma.end_vpage, vma.write_protected, vma.file_mapped);
+        }
+    }
+    printf("#### instruction simulation ######\n");
+
+    // Exiting processes and the instruction after which each one exits
+    std::vector<unsigned long> exit_at(params.procs, ULONG_MAX);
+    for (int i = 0; i < std::min(params.exits, params.procs); ++i) {
+        exit_at[params.procs - 1 - i] = params.inst / 4 + (unsigned long)(rng.uniform() * params.inst * 3 / 4);
+    }
+
+    std::vector<int> position(params.procs);
+    for (auto& pos : position) pos = rng.below(params.pages);
+    std::vector<int> running(params.procs);
+    for (int pid = 0; pid < params.procs; ++pid) running[pid] = pid;
+
+    double mean_distance = params.pages / (4.0 * params.lambda);
+    int current = -1;
+    unsigned long emitted = 0;
+    while (emitted < params.inst && !running.empty()) {
+        int next = running[rng.below(running.size())];
+        if (next == current && running.size() > 1) continue;
+        current = next;
+        printf("c %d\n", current);
+
+        int burst = 1 + rng.below(2 * params.burst - 1);
+        for (int i = 0; i < burst && emitted < params.inst; ++i, ++emitted) {
+            double distance = -mean_distance * std::log(1.0 - rng.uniform());
+            int step = static_cast<int>(std::lround(distance)) % params.pages;
+            if (rng.below(2)) step = -step;
+            position[current] = (position[current] + step + params.pages) % params.pages;
+            printf("%c %d\n", rng.uniform() * 100.0 < params.read ? 'r' : 'w', position[current]);
+        }
+        if (emitted >= exit_at[current]) {
+            printf("e %d\n", current);
+            running.erase(std::find(running.begin(), running.end(), current));
+        }
+    }
+}
+
+void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [procs=N] [vmas=N] [inst=N] [pages=N] [read=PCT] [lambda=X]"
+              << " [holes=N] [wprot=N] [mmap=N] [seed=N] [burst=N] [exits=N]\n";
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[]) {
+    GenParams params;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (eq == std::string::npos) usage(argv[0]);
+        // Accept the header spelling ("#vmas", "%read") as well
+        size_t skip = (arg[0] == '#' || arg[0] == '%') ? 1 : 0;
+        std::string key = arg.substr(skip, eq - skip);
+        const char* value = arg.c_str() + eq + 1;
+        try {
+            if (key == "procs") params.procs = std::stoi(value);
+            else if (key == "vmas") params.vmas = std::stoi(value);
+            else if (key == "inst") params.inst = std::stoul(value);
+            else if (key == "pages") params.pages = std::stoi(value);
+            else if (key == "read") params.read = std::stod(value);
+            else if (key == "lambda") params.lambda = std::stod(value);
+            else if (key == "holes") params.holes = std::stoi(value);
+            else if (key == "wprot") params.wprot = std::stoi(value);
+            else if (key == "mmap") params.mmap = std::stoi(value);
+            else if (key == "seed") params.seed = std::stoul(value);
+            else if (key == "burst") params.burst = std::stoi(value);
+            else if (key == "exits") params.exits = std::stoi(value);
+            else usage(argv[0]);
+        } catch (const std::exception& e) {
+            usage(argv[0]);
+        }
+    }
+
+    if (params.procs < 1 || params.vmas < 1 || params.pages < 1 || params.pages > 64 ||
+        params.lambda <= 0 || params.burst < 1 || params.holes < 0 || params.wprot < 0 || params.mmap < 0) {
+        std::cerr << "Invalid generator parameters (pages must be between 1 and 64)\n";
+        exit(EXIT_FAILURE);
+    }
+
+    generate(params);
+    return 0;
+}
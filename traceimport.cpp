@@ -0,0 +1,453 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <cctype>
+#include <unordered_map>
+#include <zlib.h>
+
+// Converts real memory access traces into the mmu input format:
+//
+//   valgrind --tool=lackey --trace-mem=yes ./prog 2> lackey.txt
+//   ./traceimport format=lackey lackey.txt > trace
+//
+//   perf mem record ./prog && perf script -F pid,event,addr > perf.txt
+//   ./traceimport format=perf perf.txt > trace
+//
+// raw input is a sequence of little-endian 64-bit records: the address in
+// bits 0-47, the process id in bits 48-62 and bit 63 set for writes.
+// Inputs may be gzip compressed.
+//
+// mmu processes have 64 virtual pages, so every process gets the smallest
+// power-of-two page size (at least page=) at which the pages it touches fit
+// in 64. Runs of consecutive touched pages become VMAs, placed next to each
+// other. The file is read twice: the first pass finds the page sizes keeping
+// at most 64 pages per process, the second writes the trace. Memory use does
+// not depend on the length of the trace.
+
+const int NUM_VIRTUAL_PAGES = 64;
+
+enum Format { LACKEY, PERF, RAW };
+
+struct ImportParams {
+    Format format = LACKEY;
+    std::string input;
+    uint64_t page = 4096;   // Smallest page size
+    bool dedupe = false;    // One record (with a count) per run of references to the same page
+    bool code = false;      // Include instruction fetches (lackey 'I') as reads
+};
+
+enum PageFlags : uint8_t { CODE = 1, DATA = 2, WRITTEN = 4 };
+
+struct ImportedProcess {
+    uint64_t pid;                    // Process id in the input
+    int shift;                       // log2 of the page size
+    std::vector<uint64_t> pages;     // Touched pages (address >> shift), sorted
+    std::vector<uint8_t> flags;
+    unsigned long refs = 0;
+    uint64_t last_page = UINT64_MAX; // Lookup cache: consecutive references mostly hit the same page
+    int last_index = -1;
+
+    int find(uint64_t page) {
+        if (page == last_page) return last_index;
+        auto it = std::lower_bound(pages.begin(), pages.end(), page);
+        if (it == pages.end() || *it != page) return -1;
+        last_page = page;
+        last_index = it - pages.begin();
+        return last_index;
+    }
+
+    void add(uint64_t address, uint8_t flag) {
+        uint64_t page = address >> shift;
+        int index = find(page);
+        if (index == -1) {
+            auto it = std::lower_bound(pages.begin(), pages.end(), page);
+            index = it - pages.begin();
+            pages.insert(it, page);
+            flags.insert(flags.begin() + index, 0);
+            last_page = UINT64_MAX;
+        }
+        flags[index] |= flag;
+        while (pages.size() > NUM_VIRTUAL_PAGES) coarsen();
+    }
+
+    // Double the page size, merging pages that now coincide
+    void coarsen() {
+        shift++;
+        size_t out = 0;
+        for (size_t i = 0; i < pages.size(); ++i) {
+            uint64_t page = pages[i] >> 1;
+            if (out > 0 && pages[out - 1] == page) {
+                flags[out - 1] |= flags[i];
+            } else {
+                pages[out] = page;
+                flags[out++] = flags[i];
+            }
+        }
+        pages.resize(out);
+        flags.resize(out);
+        last_page = UINT64_MAX;
+    }
+};
+
+// Buffered reader over zlib, which reads plain files unchanged
+class Input {
+private:
+    gzFile gz = nullptr;
+    std::vector<char> buffer = std::vector<char>(1 << 20);
+    size_t start = 0, end = 0;
+    bool eof = false;
+
+    bool refill() {
+        if (eof) return false;
+        memmove(buffer.data(), buffer.data() + start, end - start);
+        end -= start;
+        start = 0;
+        int n = gzread(gz, buffer.data() + end, buffer.size() - end);
+        if (n < 0) {
+            int errnum;
+            std::cerr << "Read error: " << gzerror(gz, &errnum) << "\n";
+            exit(EXIT_FAILURE);
+        }
+        if (n == 0) eof = true;
+        end += n;
+        return n > 0;
+    }
+
+public:
+    ~Input() {
+        if (gz) gzclose(gz);
+    }
+
+    bool open(const std::string& filename) {
+        gz = gzopen(filename.c_str(), "rb");
+        if (!gz) return false;
+        gzbuffer(gz, 1 << 20);
+        return true;
+    }
+
+    void rewind() {
+        gzrewind(gz);
+        start = end = 0;
+        eof = false;
+    }
+
+    // Next line without the newline, valid until the next call
+    bool next_line(const char*& line, size_t& length) {
+        while (true) {
+            const char* newline = static_cast<const char*>(memchr(buffer.data() + start, '\n', end - start));
+            if (newline) {
+                line = buffer.data() + start;
+                length = newline - line;
+                start += length + 1;
+                return true;
+            }
+            if (end - start == buffer.size()) {
+                std::cerr << "Input line longer than " << buffer.size() << " bytes\n";
+                exit(EXIT_FAILURE);
+            }
+            if (!refill()) {
+                if (start == end) return false;
+                line = buffer.data() + start;  // Last line without a newline
+                length = end - start;
+                start = end;
+                return true;
+            }
+        }
+    }
+
+    bool next_record(uint64_t& record) {
+        if (end - start < sizeof(record)) {
+            refill();
+            if (end - start < sizeof(record)) return false;
+        }
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(buffer.data() + start);
+        record = 0;
+        for (int i = 7; i >= 0; --i) record = (record << 8) | p[i];
+        start += sizeof(record);
+        return true;
+    }
+};
+
+int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Whole token [p, end) as hex, with an optional 0x prefix
+bool parse_hex(const char* p, const char* end, uint64_t& value) {
+    if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) p += 2;
+    if (p == end) return false;
+    value = 0;
+    for (; p < end; ++p) {
+        int digit = hex_digit(*p);
+        if (digit < 0) return false;
+        value = (value << 4) | digit;
+    }
+    return true;
+}
+
+// " L 04222cac,4": instruction fetches (I), loads (L), stores (S) and modifies (M)
+bool parse_lackey(const char* line, size_t length, bool code, uint64_t& address, bool& write, bool& fetch) {
+    const char* end = line + length;
+    const char* p = line;
+    while (p < end && *p == ' ') p++;
+    if (p == end || p + 1 == end || p[1] != ' ') return false;  // Also skips "==pid==" lines
+    char kind = *p++;
+    if (kind != 'L' && kind != 'S' && kind != 'M' && !(kind == 'I' && code)) return false;
+    while (p < end && *p == ' ') p++;
+    const char* comma = static_cast<const char*>(memchr(p, ',', end - p));
+    if (!comma || !parse_hex(p, comma, address)) return false;
+    write = kind == 'S' || kind == 'M';
+    fetch = kind == 'I';
+    return true;
+}
+
+// "perf script -F pid,event,addr": "  1234 cpu/mem-stores/P:  7ffd4e3c1a38".
+// The pid is the first token (pid/tid is accepted), the address the last one;
+// events mentioning "store" are writes, everything else reads.
+bool parse_perf(const char* line, size_t length, uint64_t& pid, uint64_t& address, bool& write) {
+    const char* end = line + length;
+    const char* p = line;
+    // Next blank-separated token as [start, stop); false at the end of the line
+    auto next_token = [&](const char*& start, const char*& stop) {
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+        start = p;
+        while (p < end && *p != ' ' && *p != '\t') p++;
+        stop = p;
+        return stop > start;
+    };
+    const char *start, *stop;
+    if (!next_token(start, stop) || !isdigit(*start)) return false;
+    pid = 0;
+    for (; start < stop && isdigit(*start); ++start) pid = pid * 10 + (*start - '0');
+
+    // Every token but the last one is part of the event
+    const char *last = nullptr, *last_stop = nullptr;
+    write = false;
+    while (next_token(start, stop)) {
+        if (last && std::string_view(last, last_stop - last).find("store") != std::string_view::npos) write = true;
+        last = start;
+        last_stop = stop;
+    }
+    return last && parse_hex(last, last_stop, address);
+}
+
+// Calls visit(pid, address, write, fetch) for every reference in the input
+template <class Visit>
+void scan(Input& input, const ImportParams& params, Visit visit) {
+    uint64_t pid = 0, address;
+    bool write, fetch = false;
+    if (params.format == RAW) {
+        uint64_t record;
+        while (input.next_record(record)) {
+            visit((record >> 48) & 0x7fff, record & 0xffffffffffffULL, record >> 63, false);
+        }
+        return;
+    }
+    const char* line;
+    size_t length;
+    while (input.next_line(line, length)) {
+        if (params.format == LACKEY ? parse_lackey(line, length, params.code, address, write, fetch)
+                                    : parse_perf(line, length, pid, address, write)) {
+            visit(pid, address, write, fetch);
+        }
+    }
+}
+
+// Output buffer, much faster than printf for hundreds of millions of lines
+class Output {
+private:
+    std::vector<char> buffer = std::vector<char>(1 << 20);
+    size_t used = 0;
+
+public:
+    ~Output() {
+        flush();
+    }
+
+    static char* append_number(char* p, unsigned long value) {
+        char digits[20];
+        int n = 0;
+        do {
+            digits[n++] = '0' + value % 10;
+            value /= 10;
+        } while (value);
+        while (n) *p++ = digits[--n];
+        return p;
+    }
+
+    void flush() {
+        fwrite(buffer.data(), 1, used, stdout);
+        used = 0;
+    }
+
+    void record(char operation, unsigned long value, unsigned long count = 1) {
+        if (used + 64 > buffer.size()) flush();
+        char* p = buffer.data() + used;
+        *p++ = operation;
+        *p++ = ' ';
+        p = append_number(p, value);
+        if (count > 1) {
+            *p++ = ' ';
+            p = append_number(p, count);
+        }
+        *p++ = '\n';
+        used = p - buffer.data();
+    }
+};
+
+const char* const FORMAT_NAMES[] = { "lackey", "perf", "raw" };
+
+void import_trace(const ImportParams& params) {
+    Input input;
+    if (!input.open(params.input)) {
+        std::cerr << "Failed to open " << params.input << "\n";
+        exit(EXIT_FAILURE);
+    }
+    int base_shift = 0;
+    while ((2ULL << base_shift) <= params.page) base_shift++;
+
+    // Pass 1: processes and the pages they touch
+    std::vector<ImportedProcess> procs;
+    std::unordered_map<uint64_t, int> index_of;
+    uint64_t last_pid = UINT64_MAX;
+    int last_index = -1;
+    auto process_index = [&](uint64_t pid) {
+        if (pid == last_pid) return last_index;
+        auto it = index_of.find(pid);
+        if (it == index_of.end()) {
+            it = index_of.emplace(pid, procs.size()).first;
+            procs.push_back(ImportedProcess());
+            procs.back().pid = pid;
+            procs.back().shift = base_shift;
+        }
+        last_pid = pid;
+        return last_index = it->second;
+    };
+    scan(input, params, [&](uint64_t pid, uint64_t address, bool write, bool fetch) {
+        ImportedProcess& proc = procs[process_index(pid)];
+        proc.add(address, fetch ? CODE : write ? DATA | WRITTEN : DATA);
+        proc.refs++;
+    });
+    if (procs.empty()) {
+        std::cerr << "No memory references found in " << params.input << " (format=" << FORMAT_NAMES[params.format] << ")\n";
+        exit(EXIT_FAILURE);
+    }
+
+    printf("#imported from %s (format=%s)\n", params.input.c_str(), FORMAT_NAMES[params.format]);
+    for (size_t i = 0; i < procs.size(); ++i) {
+        printf("#\tprocess %zu: pid=%lu refs=%lu pages=%zu pagesize=%llu\n", i, (unsigned long)procs[i].pid,
+               procs[i].refs, procs[i].pages.size(), 1ULL << procs[i].shift);
+    }
+    printf("%zu\n", procs.size());
+    for (size_t i = 0; i < procs.size(); ++i) {
+        // VMAs: runs of adjacent pages of the same kind. Code that is never
+        // written is mapped read-only and file backed.
+        const ImportedProcess& proc = procs[i];
+        std::vector<std::string> vmas;
+        for (size_t first = 0, last; first < proc.pages.size(); first = last + 1) {
+            bool is_code = proc.flags[first] == CODE;
+            last = first;
+            while (last + 1 < proc.pages.size() && proc.pages[last + 1] == proc.pages[last] + 1 &&
+                   (proc.flags[last + 1] == CODE) == is_code) {
+                last++;
+            }
+            vmas.push_back(std::to_string(first) + " " + std::to_string(last) + (is_code ? " 1 1" : " 0 0"));
+        }
+        printf("#### process %zu\n#\n%zu\n", i, vmas.size());
+        for (const auto& vma : vmas) printf("%s\n", vma.c_str());
+    }
+    printf("#### instruction simulation ######\n");
+    fflush(stdout);
+
+    // Pass 2: the references, as virtual pages of the compacted address spaces
+    Output output;
+    input.rewind();
+    int current = -1, pending_page = -1;
+    bool pending_write = false;
+    unsigned long pending_count = 0, records = 0;
+    auto flush_pending = [&]() {
+        if (pending_count) output.record(pending_write ? 'w' : 'r', pending_page, pending_count);
+        pending_count = 0;
+    };
+    scan(input, params, [&](uint64_t pid, uint64_t address, bool write, bool) {
+        int index = process_index(pid);
+        ImportedProcess& proc = procs[index];
+        int vpage = proc.find(address >> proc.shift);
+        if (params.dedupe && index == current && vpage == pending_page) {
+            pending_write |= write;
+            pending_count++;
+            return;
+        }
+        flush_pending();
+        if (index != current) {
+            output.record('c', index);
+            current = index;
+        }
+        pending_page = vpage;
+        pending_write = write;
+        pending_count = 1;
+        records++;
+        if (!params.dedupe) flush_pending();
+    });
+    flush_pending();
+
+    unsigned long refs = 0;
+    for (const auto& proc : procs) refs += proc.refs;
+    std::cerr << "traceimport: " << refs << " references, " << records << " records, " << procs.size() << " processes\n";
+}
+
+void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " format=lackey|perf|raw [page=BYTES] [dedupe=0|1] [code=0|1] inputfile\n";
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[]) {
+    ImportParams params;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (eq == std::string::npos) {
+            if (!params.input.empty()) usage(argv[0]);
+            params.input = arg;
+            continue;
+        }
+        std::string key = arg.substr(0, eq);
+        std::string value = arg.substr(eq + 1);
+        try {
+            if (key == "format") {
+                if (value == "lackey") params.format = LACKEY;
+                else if (value == "perf") params.format = PERF;
+                else if (value == "raw") params.format = RAW;
+                else usage(argv[0]);
+            }
+            else if (key == "page") params.page = std::stoull(value);
+            else if (key == "dedupe") params.dedupe = std::stoi(value);
+            else if (key == "code") params.code = std::stoi(value);
+            else usage(argv[0]);
+        } catch (const std::exception& e) {
+            usage(argv[0]);
+        }
+    }
+
+    if (params.input.empty() || params.input == "-") {
+        std::cerr << "traceimport reads its input twice and needs a file (gzip compressed is fine)\n";
+        exit(EXIT_FAILURE);
+    }
+    if (params.page == 0 || (params.page & (params.page - 1))) {
+        std::cerr << "Page size must be a power of two\n";
+        exit(EXIT_FAILURE);
+    }
+
+    import_trace(params);
+    return 0;
+}